@@ -0,0 +1,2408 @@
+// libwellness: definitions for wellness_core.h and the C ABI declared in
+// wellness.h. Only the C ABI is exported from libwellness.so; the
+// command-line program links libwellness.a for the C++ classes.
+
+#include "wellness_core.h"
+#include "wellness.h"
+
+bool WellnessBot::parseWeight(const string& text, double& kg) {
+    const char* p = text.c_str();
+    double number;
+    if (!parseNumber(p, number))
+        return false;
+    string unit = parseUnit(p);
+    if (unit == "lb" || unit == "lbs" || unit == "pound" || unit == "pounds")
+        number *= KG_PER_POUND;
+    else if (!unit.empty() && unit != "kg")
+        return false;
+    kg = number;
+    return atEnd(p);
+}
+
+void WellnessBot::MessageCatalog::write(ostream& out, uint16_t id, initializer_list<string_view> args) const {
+    const char* start = text(id);
+    const string_view* next = args.begin();
+    for (const char* p = start; *p; p++) {
+        if (p[0] == '{' && p[1] == '}' && next != args.end()) {
+            out.write(start, p - start);
+            out.write(next->data(), static_cast<streamsize>(next->size()));
+            next++;
+            start = ++p + 1;
+        }
+    }
+    out << start;
+}
+
+WellnessBot::FormattedNumber WellnessBot::localizeNumber(const char* digits, const char* end,
+                                                         const MessageCatalog& catalog) {
+    FormattedNumber number;
+    const char* p = digits;
+    if (p < end && *p == '-')
+        number.text[number.size++] = *p++;
+    const char* integerEnd = p;
+    while (integerEnd < end && *integerEnd >= '0' && *integerEnd <= '9')
+        integerEnd++;
+    size_t integerDigits = integerEnd - p;
+    for (size_t i = 0; i < integerDigits; i++) {
+        if (catalog.groupSeparator && i > 0 && (integerDigits - i) % 3 == 0)
+            number.text[number.size++] = catalog.groupSeparator;
+        number.text[number.size++] = p[i];
+    }
+    for (p = integerEnd; p < end; p++)
+        number.text[number.size++] = *p == '.' ? catalog.decimalSeparator : *p;
+    return number;
+}
+
+void WellnessBot::GrowthChart::zScores(const uint8_t* age, const uint8_t* gender, const double* bmi,
+                                       double* z, double* percentiles, size_t begin, size_t end) const {
+    const double nan = numeric_limits<double>::quiet_NaN();
+    for (size_t i = begin; i < end; i++) {
+        bool valid = covers(age[i]) && gender[i] < GENDER_COUNT;
+        // Invalid rows read a valid entry and discard the result
+        size_t row = valid ? index(gender[i], age[i]) : 0;
+        double score = lmsZScore(bmi[i], l[row], m[row], s[row]);
+        z[i] = valid ? score : nan;
+    }
+    if (percentiles) {
+        for (size_t i = begin; i < end; i++)
+            percentiles[i] = percentile(z[i]);
+    }
+}
+
+void WellnessBot::calculateMetrics(UserProfile& profile, const WellnessConfig& cfg) {
+    bool male = profile.gender == "male";
+
+    // Calculate BMI
+    profile.bmi = profile.weight / pow(profile.height, 2);
+
+    // Estimate body composition
+    profile.bodyFatPercent = bodyFatPercent(male, profile.height, profile.bmi, profile.age,
+                                            profile.waist, profile.neck, profile.hip);
+    profile.leanBodyMass = profile.weight * (1.0 - profile.bodyFatPercent / 100.0);
+
+    // Calculate BMR using Mifflin-St Jeor Equation, or Katch-McArdle from lean mass
+    if (cfg.bmrFormula == BMR_KATCH_MCARDLE) {
+        profile.bmr = katchMcArdle(profile.leanBodyMass);
+    } else {
+        profile.bmr = basalMetabolicRate(male, profile.weight, profile.height, profile.age);
+    }
+
+    // Calculate daily caloric needs
+    uint8_t activity = encodeActivityLevel(profile.activityLevel);
+    if (activity < ACTIVITY_COUNT) {
+        profile.dailyCalories = profile.bmr * cfg.activityMultipliers[activity];
+    }
+}
+
+void WellnessBot::displayResults(const UserProfile& profile, ostream& out, const WellnessConfig& cfg,
+                                 const MacroGrams& grams, const MessageCatalog& catalog) const {
+    out << "\n";
+    catalog.write(out, MSG_RESULTS_TITLE);
+    out << "\n\n";
+
+    // Display BMI, with the category from BMI-for-age percentiles for children
+    const GrowthChart* chart = growthChart();
+    uint8_t gender = encodeGender(profile.gender);
+    BMICategory category = bmiCategory(profile.bmi, profile.age, gender, cfg, chart);
+    catalog.write(out, MSG_BMI, {formatNumber(profile.bmi, 2, catalog),
+                                 catalog.text(MESSAGE_BMI_CATEGORY + category)});
+    out << "\n";
+    if (usesGrowthChart(chart, profile.age, gender)) {
+        double zScore = chart->zScore(gender, profile.age, profile.bmi);
+        double percentile = GrowthChart::percentile(zScore);
+        catalog.write(out, MSG_BMI_FOR_AGE, {formatNumber(percentile, 1, catalog),
+                                             formatNumber(zScore, 2, catalog)});
+        out << "\n";
+    }
+    out << "\n";
+
+    // Display BMR and daily caloric needs
+    catalog.write(out, MSG_BMR, {formatNumber(profile.bmr, 2, catalog)});
+    out << "\n";
+    catalog.write(out, MSG_DAILY_CALORIES, {formatNumber(profile.dailyCalories, 2, catalog)});
+    out << "\n";
+
+    // Display body composition when it was measured or drives the BMR
+    bool measured = hasCircumferences(profile.gender == "male", profile.waist, profile.neck,
+                                      profile.hip);
+    if (measured || cfg.bmrFormula == BMR_KATCH_MCARDLE) {
+        out << "\n";
+        catalog.write(out, MSG_BODY_FAT, {formatNumber(profile.bodyFatPercent, 2, catalog),
+                                          catalog.text(measured ? MSG_METHOD_NAVY : MSG_METHOD_BMI)});
+        out << "\n";
+        catalog.write(out, MSG_LEAN_BODY_MASS, {formatNumber(profile.leanBodyMass, 2, catalog)});
+        out << "\n";
+    }
+
+    // Display macronutrients
+    out << "\n";
+    catalog.write(out, MSG_MACROS_TITLE);
+    out << "\n  - ";
+    catalog.write(out, MSG_CARBS, {formatNumber(grams.carbs, 2, catalog)});
+    out << "\n  - ";
+    catalog.write(out, MSG_PROTEIN, {formatNumber(grams.protein, 2, catalog)});
+    out << "\n  - ";
+    catalog.write(out, MSG_FATS, {formatNumber(grams.fats, 2, catalog)});
+    out << "\n";
+
+    provideRecommendations(profile, out, cfg, catalog);
+}
+
+void WellnessBot::renderRecommendations(const Recommendations& recs, const MessageCatalog& catalog,
+                                        ostream& out) {
+    int section = -1;
+    for (uint8_t i = 0; i < recs.count; i++) {
+        uint16_t id = recs.ids[i];
+        if (RECOMMENDATION_SECTION[id] != section) {
+            section = RECOMMENDATION_SECTION[id];
+            out << "\n" << catalog.sectionTitle(section) << ":\n";
+        }
+        out << "- " << catalog.text(id) << "\n";
+    }
+}
+
+uint32_t WellnessBot::recommendationMask(BMICategory category, int sleepHours, uint8_t diet,
+                                         uint8_t lifestyle) {
+    uint32_t highBmi = 0u - static_cast<uint32_t>(category >= BMI_OVERWEIGHT);
+    uint32_t shortSleep = 0u - static_cast<uint32_t>(sleepHours < 7);
+    uint32_t vegetarian = 0u - static_cast<uint32_t>(diet == DIET_VEGETARIAN);
+    uint32_t vegan = 0u - static_cast<uint32_t>(diet == DIET_VEGAN);
+    uint32_t smoking = 0u - static_cast<uint32_t>(lifestyle == LIFESTYLE_SMOKING);
+    uint32_t alcohol = 0u - static_cast<uint32_t>(lifestyle == LIFESTYLE_ALCOHOL);
+    return (highBmi & HIGH_BMI_RECOMMENDATIONS) | (~highBmi & HEALTHY_BMI_RECOMMENDATIONS) |
+           (shortSleep & SHORT_SLEEP_RECOMMENDATIONS) | (~shortSleep & ENOUGH_SLEEP_RECOMMENDATIONS) |
+           (vegetarian & VEGETARIAN_RECOMMENDATIONS) | (vegan & VEGAN_RECOMMENDATIONS) |
+           (~(vegetarian | vegan) & OTHER_DIET_RECOMMENDATIONS) |
+           (smoking & SMOKING_RECOMMENDATIONS) | (alcohol & ALCOHOL_RECOMMENDATIONS);
+}
+
+bool WellnessBot::parseLength(const string& text, double baseMicrometers, double& value) {
+    const char* p = text.c_str();
+    double number;
+    if (!parseNumber(p, number))
+        return false;
+    double unitMicrometers = lengthUnit(parseUnit(p));
+    if (unitMicrometers == 0)
+        unitMicrometers = baseMicrometers;
+    else if (unitMicrometers < 0)
+        return false;
+    double micrometers = number * unitMicrometers;
+    if (unitMicrometers == MICROMETERS_PER_FOOT) {
+        const char* inchesStart = p;
+        double inches;
+        if (parseNumber(p, inches)) {
+            double inchUnit = lengthUnit(parseUnit(p));
+            if ((inchUnit != 0 && inchUnit != MICROMETERS_PER_INCH) || !(inches >= 0 && inches < 12))
+                return false;
+            micrometers += inches * MICROMETERS_PER_INCH;
+        } else {
+            p = inchesStart;
+        }
+    }
+    value = unitMicrometers == baseMicrometers ? number : micrometers / baseMicrometers;
+    return atEnd(p);
+}
+
+string WellnessBot::parseUnit(const char*& p) {
+    while (*p == ' ' || *p == '\t')
+        p++;
+    if (*p == '\'' || *p == '"')
+        return string(1, *p++);
+    string unit;
+    while (isalpha(static_cast<unsigned char>(*p)))
+        unit += static_cast<char>(tolower(static_cast<unsigned char>(*p++)));
+    return unit;
+}
+
+ConfigFile::WellnessConfig ConfigFile::parse(const string& text) {
+    WellnessConfig config = WellnessBot::defaultConfig();
+    stringstream lines(text);
+    string line;
+    int lineNumber = 0;
+    while (getline(lines, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t\r") == string::npos)
+            continue;
+        size_t equals = line.find('=');
+        if (equals == string::npos)
+            throw invalid_argument(where(lineNumber) + "expected key = value");
+        string key = trim(line.substr(0, equals));
+        string text = trim(line.substr(equals + 1));
+        if (key == "bmr.formula") {
+            uint8_t formula = WellnessBot::encodeName(text, WellnessBot::BMR_FORMULA_NAMES,
+                                                      WellnessBot::BMR_FORMULA_COUNT);
+            if (formula == WellnessBot::BMR_FORMULA_COUNT)
+                throw invalid_argument(where(lineNumber) + "unknown BMR formula " + text);
+            config.bmrFormula = static_cast<WellnessBot::BmrFormula>(formula);
+            continue;
+        }
+        char* end;
+        double value = strtod(text.c_str(), &end);
+        if (text.empty() || *end != '\0' || !isfinite(value))
+            throw invalid_argument(where(lineNumber) + "invalid number for " + key);
+        double* field = fieldFor(config, key);
+        if (!field)
+            throw invalid_argument(where(lineNumber) + "unknown key " + key);
+        *field = value;
+    }
+    validate(config);
+    config.rebuildMacroProfiles();
+    return config;
+}
+
+double* ConfigFile::fieldFor(WellnessConfig& config, const string& key) {
+    if (key == "bmi.underweight") return &config.bmiThresholds.underweight;
+    if (key == "bmi.normal") return &config.bmiThresholds.normal;
+    if (key == "bmi.overweight") return &config.bmiThresholds.overweight;
+    if (key == "macros.carbs") return &config.macros.carbs;
+    if (key == "macros.protein") return &config.macros.protein;
+    if (key == "macros.fats") return &config.macros.fats;
+    if (key.compare(0, 9, "activity.") == 0) {
+        uint8_t level = WellnessBot::encodeActivityLevel(key.substr(9));
+        if (level < WellnessBot::ACTIVITY_COUNT)
+            return &config.activityMultipliers[level];
+    }
+    return nullptr;
+}
+
+void ConfigFile::validate(const WellnessConfig& config) {
+    const WellnessBot::BMIThresholds& t = config.bmiThresholds;
+    if (!(0 < t.underweight && t.underweight < t.normal && t.normal < t.overweight))
+        throw invalid_argument("BMI thresholds must be positive and increasing");
+    const WellnessBot::MacroRatio& m = config.macros;
+    if (m.carbs < 0 || m.protein < 0 || m.fats < 0 ||
+        fabs(m.carbs + m.protein + m.fats - 1.0) > 1e-6)
+        throw invalid_argument("Macro ratios must be non-negative and sum to 1");
+    for (double multiplier : config.activityMultipliers) {
+        if (!(multiplier > 0))
+            throw invalid_argument("Activity multipliers must be positive");
+    }
+}
+
+MessageCatalogFile::MessageCatalogFile(const string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw runtime_error("Cannot read message catalog: " + path);
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        size = static_cast<size_t>(st.st_size);
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        data = mapped == MAP_FAILED ? nullptr : static_cast<const char*>(mapped);
+    }
+    close(fd);
+    if (!data)
+        throw runtime_error("Cannot map message catalog: " + path);
+    if (!validate()) {
+        munmap(const_cast<char*>(data), size);
+        throw runtime_error("Not a message catalog for this build: " + path +
+                            " (compile it again with --compile-catalog)");
+    }
+    const Header* header = reinterpret_cast<const Header*>(data);
+    catalogView.locale = header->locale;
+    catalogView.offsets = reinterpret_cast<const uint16_t*>(data + sizeof(Header));
+    catalogView.strings = data + stringsOffset(header->messageCount);
+    catalogView.decimalSeparator = header->decimalSeparator;
+    catalogView.groupSeparator = header->groupSeparator;
+}
+
+string MessageCatalogFile::compile(const string& text, size_t& untranslated) {
+    const MessageCatalog& english = WellnessBot::ENGLISH_CATALOG;
+    unordered_map<string, uint16_t> ids;
+    for (uint16_t id = 0; id < WellnessBot::MESSAGE_COUNT; id++)
+        ids.emplace(english.text(id), id);
+
+    Header header = {};
+    memcpy(header.magic, MAGIC, sizeof(header.magic));
+    header.version = FORMAT_VERSION;
+    header.messageCount = WellnessBot::MESSAGE_COUNT;
+    header.decimalSeparator = '.';
+    vector<string> messages(WellnessBot::MESSAGE_COUNT);
+    vector<bool> translated(WellnessBot::MESSAGE_COUNT, false);
+
+    stringstream lines(text);
+    string line;
+    int lineNumber = 0;
+    while (getline(lines, line)) {
+        lineNumber++;
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.find_first_not_of(" \t") == string::npos || line[line.find_first_not_of(" \t")] == '#')
+            continue;
+        size_t equals = line.find(" = ");
+        if (equals == string::npos)
+            throw invalid_argument(where(lineNumber) + "expected text = translation");
+        string key = trim(line.substr(0, equals));
+        string value = trim(line.substr(equals + 3));
+        if (key == "locale") {
+            if (value.empty() || value.size() >= sizeof(header.locale))
+                throw invalid_argument(where(lineNumber) + "locale name must be 1 to 15 characters");
+            memcpy(header.locale, value.data(), value.size());
+        } else if (key == "decimal" || key == "group") {
+            char separator = value == "space" ? ' ' : value == "none" ? '\0' : value.size() == 1 ? value[0] : '?';
+            if (separator == '?' || (key == "decimal" && separator == '\0'))
+                throw invalid_argument(where(lineNumber) + key + " must be a single character");
+            (key == "decimal" ? header.decimalSeparator : header.groupSeparator) = separator;
+        } else {
+            auto found = ids.find(key);
+            if (found == ids.end())
+                throw invalid_argument(where(lineNumber) + "no message \"" + key + "\"");
+            if (placeholders(key) != placeholders(value))
+                throw invalid_argument(where(lineNumber) + "translation must keep the " +
+                                       to_string(placeholders(key)) + " {} placeholders");
+            messages[found->second] = value;
+            translated[found->second] = true;
+        }
+    }
+    if (header.locale[0] == '\0')
+        throw invalid_argument("Message catalog has no locale line");
+
+    string strings;
+    vector<uint16_t> offsets;
+    untranslated = 0;
+    for (uint16_t id = 0; id < WellnessBot::MESSAGE_COUNT; id++) {
+        if (!translated[id]) {
+            messages[id] = english.text(id);
+            untranslated++;
+        }
+        offsets.push_back(static_cast<uint16_t>(strings.size()));
+        strings += messages[id];
+        strings += '\0';
+        if (strings.size() > numeric_limits<uint16_t>::max())
+            throw invalid_argument("Message catalog is larger than 64 KB");
+    }
+    header.stringsSize = static_cast<uint32_t>(strings.size());
+
+    string out(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.append(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint16_t));
+    out.resize(stringsOffset(header.messageCount), '\0');
+    return out + strings;
+}
+
+bool MessageCatalogFile::validate() const {
+    if (size < sizeof(Header))
+        return false;
+    const Header* header = reinterpret_cast<const Header*>(data);
+    if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != FORMAT_VERSION ||
+        header->messageCount != WellnessBot::MESSAGE_COUNT ||
+        memchr(header->locale, '\0', sizeof(header->locale)) == nullptr ||
+        header->decimalSeparator == '\0' || header->stringsSize == 0 ||
+        size != stringsOffset(header->messageCount) + header->stringsSize)
+        return false;
+    const uint16_t* offsets = reinterpret_cast<const uint16_t*>(data + sizeof(Header));
+    const char* strings = data + stringsOffset(header->messageCount);
+    if (strings[header->stringsSize - 1] != '\0')
+        return false;
+    for (uint32_t id = 0; id < header->messageCount; id++) {
+        if (offsets[id] >= header->stringsSize)
+            return false;
+    }
+    return true;
+}
+
+GrowthChartFile::GrowthChart GrowthChartFile::parse(const string& text) {
+    struct Point {
+        double month, l, m, s;
+    };
+    vector<Point> points[WellnessBot::GENDER_COUNT];
+    int columns[COLUMN_COUNT] = {-1, -1, -1, -1, -1};
+
+    stringstream lines(text);
+    string line;
+    int lineNumber = 0;
+    while (getline(lines, line)) {
+        lineNumber++;
+        vector<string> fields = split(line);
+        if (fields.size() == 1 && fields[0].empty())
+            continue;
+        if (!fields.empty() && !fields[0].empty() && isalpha(static_cast<unsigned char>(fields[0][0]))) {
+            for (int c = 0; c < COLUMN_COUNT; c++) {
+                for (size_t f = 0; f < fields.size(); f++) {
+                    if (lower(fields[f]) == COLUMN_NAMES[c])
+                        columns[c] = static_cast<int>(f);
+                }
+            }
+            continue;
+        }
+        double values[COLUMN_COUNT];
+        for (int c = 0; c < COLUMN_COUNT; c++) {
+            if (columns[c] < 0)
+                throw invalid_argument("Growth chart needs a header with Sex, Agemos, L, M and S");
+            char* end;
+            const string& field = static_cast<size_t>(columns[c]) < fields.size() ? fields[columns[c]] : "";
+            values[c] = strtod(field.c_str(), &end);
+            if (field.empty() || *end != '\0' || !isfinite(values[c]))
+                throw invalid_argument(where(lineNumber) + "invalid " + COLUMN_NAMES[c]);
+        }
+        if (values[SEX] != 1 && values[SEX] != 2)
+            throw invalid_argument(where(lineNumber) + "sex must be 1 or 2");
+        if (!(values[M] > 0 && values[S] > 0))
+            throw invalid_argument(where(lineNumber) + "M and S must be positive");
+        vector<Point>& sexPoints = points[static_cast<int>(values[SEX]) - 1];
+        if (!sexPoints.empty() && !(values[AGEMOS] > sexPoints.back().month))
+            throw invalid_argument(where(lineNumber) + "ages must increase within each sex");
+        sexPoints.push_back({values[AGEMOS], values[L], values[M], values[S]});
+    }
+
+    GrowthChart chart;
+    for (int g = 0; g < WellnessBot::GENDER_COUNT; g++) {
+        const vector<Point>& p = points[g];
+        if (p.empty() || p.front().month > GrowthChart::FIRST_MONTH ||
+            p.back().month < GrowthChart::LAST_MONTH)
+            throw invalid_argument(string("Growth chart must cover ") +
+                                   to_string(GrowthChart::FIRST_MONTH) + " to " +
+                                   to_string(GrowthChart::LAST_MONTH) + " months for " +
+                                   WellnessBot::GENDER_NAMES[g] + "s");
+        size_t next = 0;
+        for (int month = GrowthChart::FIRST_MONTH; month <= GrowthChart::LAST_MONTH; month++) {
+            while (p[next].month < month)
+                next++;
+            const Point& hi = p[next];
+            const Point& lo = p[next > 0 && hi.month > month ? next - 1 : next];
+            double t = hi.month == lo.month ? 0.0 : (month - lo.month) / (hi.month - lo.month);
+            size_t i = static_cast<size_t>(g) * GrowthChart::MONTHS + month - GrowthChart::FIRST_MONTH;
+            chart.l[i] = lo.l + (hi.l - lo.l) * t;
+            chart.m[i] = lo.m + (hi.m - lo.m) * t;
+            chart.s[i] = lo.s + (hi.s - lo.s) * t;
+        }
+    }
+    return chart;
+}
+
+vector<string> GrowthChartFile::split(const string& line) {
+    vector<string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t comma = line.find(',', start);
+        string field = line.substr(start, comma == string::npos ? string::npos : comma - start);
+        field.erase(remove(field.begin(), field.end(), '"'), field.end());
+        size_t first = field.find_first_not_of(" \t\r");
+        size_t last = field.find_last_not_of(" \t\r");
+        fields.push_back(first == string::npos ? "" : field.substr(first, last - first + 1));
+        if (comma == string::npos)
+            return fields;
+        start = comma + 1;
+    }
+}
+
+bool HugePageArena::parseMode(const string& name, HugePages& mode) {
+    if (name == "off")
+        mode = HugePages::OFF;
+    else if (name == "thp")
+        mode = HugePages::TRANSPARENT;
+    else if (name == "2m")
+        mode = HugePages::PAGES_2MB;
+    else if (name == "1g")
+        mode = HugePages::PAGES_1GB;
+    else
+        return false;
+    return true;
+}
+
+void* HugePageArena::allocate(size_t bytes, HugePages mode) {
+    if (!usesMapping(bytes, mode))
+        return ::operator new(bytes);
+
+    size_t length = mappingLength(bytes, mode);
+    void* p = MAP_FAILED;
+    if (mode == HugePages::PAGES_1GB && length % PAGE_1GB == 0)
+        p = mapHugetlb(length, 30);
+    if (p == MAP_FAILED && (mode == HugePages::PAGES_1GB || mode == HugePages::PAGES_2MB))
+        p = mapHugetlb(length, 21);
+    if (p != MAP_FAILED) {
+        hugetlbBytesMapped() += length;
+        return p;
+    }
+
+    p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        throw bad_alloc();
+    madvise(p, length, MADV_HUGEPAGE);
+    fallbackBytesMapped() += length;
+    return p;
+}
+
+void* HugePageArena::mapHugetlb(size_t length, int pageShift) {
+#ifdef MAP_HUGETLB
+    return mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (pageShift << 26), -1, 0);
+#else
+    (void)length;
+    (void)pageShift;
+    return MAP_FAILED;
+#endif
+}
+
+bool CohortViews::insert(uint64_t userId, const UserProfile& profile) {
+    Delta delta;
+    if (!deltaFor(profile, delta))
+        return false;
+    lock_guard<mutex> lock(writeMutex);
+    if (!applied.emplace(userId, delta).second)
+        return false;
+    beginWrite();
+    apply(delta, 1);
+    endWrite();
+    return true;
+}
+
+bool CohortViews::update(uint64_t userId, const UserProfile& newProfile) {
+    Delta delta;
+    if (!deltaFor(newProfile, delta))
+        return false;
+    lock_guard<mutex> lock(writeMutex);
+    auto entry = applied.find(userId);
+    if (entry == applied.end())
+        return false;
+    beginWrite();
+    apply(entry->second, -1);
+    apply(delta, 1);
+    endWrite();
+    entry->second = delta;
+    return true;
+}
+
+bool CohortViews::remove(uint64_t userId) {
+    lock_guard<mutex> lock(writeMutex);
+    auto entry = applied.find(userId);
+    if (entry == applied.end())
+        return false;
+    beginWrite();
+    apply(entry->second, -1);
+    endWrite();
+    applied.erase(entry);
+    return true;
+}
+
+CohortViews::Snapshot CohortViews::snapshot() const {
+    Snapshot snap;
+    while (true) {
+        uint64_t before = sequence.load(memory_order_acquire);
+        if (before & 1) {
+            this_thread::yield();
+            continue;
+        }
+        for (int i = 0; i < CELL_COUNT; i++) {
+            snap.counts[i] = counts[i].load(memory_order_relaxed);
+            snap.milliCalories[i] = milliCalories[i].load(memory_order_relaxed);
+        }
+        atomic_thread_fence(memory_order_acquire);
+        if (sequence.load(memory_order_relaxed) == before) {
+            snap.version = before / 2;
+            return snap;
+        }
+    }
+}
+
+CohortViews::Snapshot CohortViews::rebuild(const WellnessBot& bot, const vector<UserProfile>& population,
+                                           unsigned threadCount) {
+    if (threadCount == 0)
+        threadCount = 1;
+    vector<Snapshot> partials(threadCount);
+    vector<thread> workers;
+    size_t chunk = (population.size() + threadCount - 1) / threadCount;
+    const WellnessConfig& cfg = bot.config();
+    const GrowthChart* chart = bot.growthChart();
+
+    for (unsigned t = 0; t < threadCount; t++) {
+        workers.emplace_back([&, t]() {
+            size_t begin = min(population.size(), t * chunk);
+            size_t end = min(population.size(), begin + chunk);
+            for (size_t i = begin; i < end; i++)
+                partials[t].add(cfg, chart, population[i]);
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+
+    Snapshot result;
+    for (const auto& local : partials)
+        result.merge(local);
+    return result;
+}
+
+void SketchHash::hashBatch(const uint64_t* keys, size_t count, uint32_t seed, uint64_t* out) {
+    size_t i = 0;
+#ifdef __AVX2__
+    const __m256i idx = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    const __m256i seedA = _mm256_set1_epi32(static_cast<int>(seed));
+    const __m256i seedB = _mm256_set1_epi32(static_cast<int>(seed * 0x9e3779b9u));
+    for (; i + 8 <= count; i += 8) {
+        // Split eight 64-bit keys into a vector of low halves and one of high halves
+        __m256i k0 = _mm256_permutevar8x32_epi32(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)), idx);
+        __m256i k1 = _mm256_permutevar8x32_epi32(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i + 4)), idx);
+        __m256i lo = _mm256_permute2x128_si256(k0, k1, 0x20);
+        __m256i hi = _mm256_permute2x128_si256(k0, k1, 0x31);
+
+        __m256i a = _mm256_xor_si256(
+            _mm256_xor_si256(_mm256_mullo_epi32(lo, _mm256_set1_epi32(static_cast<int>(0xcc9e2d51u))), hi),
+            seedA);
+        a = fmix32x8(a);
+        __m256i b = _mm256_xor_si256(
+            _mm256_xor_si256(_mm256_mullo_epi32(hi, _mm256_set1_epi32(static_cast<int>(0x1b873593u))), a),
+            seedB);
+        b = fmix32x8(b);
+
+        // Interleave back into 64-bit lanes: (b << 32) | a
+        __m256i low = _mm256_unpacklo_epi32(a, b);
+        __m256i high = _mm256_unpackhi_epi32(a, b);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                            _mm256_permute2x128_si256(low, high, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 4),
+                            _mm256_permute2x128_si256(low, high, 0x31));
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = hash64(keys[i], seed);
+    }
+}
+
+double HyperLogLog::estimate() const {
+    double m = static_cast<double>(registers.size());
+    double sum = 0.0;
+    size_t zeros = 0;
+    for (uint8_t r : registers) {
+        sum += ldexp(1.0, -r);
+        if (r == 0)
+            zeros++;
+    }
+    double alpha = 0.7213 / (1.0 + 1.079 / m);
+    double raw = alpha * m * m / sum;
+    // Small-range correction: fall back to linear counting
+    if (raw <= 2.5 * m && zeros != 0)
+        return m * log(m / zeros);
+    return raw;
+}
+
+CountMinSketch CountMinSketch::deserialize(const string& in, size_t& pos) {
+    uint32_t depth = SketchCodec::getU32(in, pos);
+    uint32_t width = SketchCodec::getU32(in, pos);
+    if (depth < 1 || depth > MAX_DEPTH || width < 1 || width > MAX_WIDTH)
+        throw runtime_error("Invalid Count-Min sketch dimensions in serialized data");
+    SketchCodec::need(in, pos, size_t(depth) * width * sizeof(uint64_t));
+    CountMinSketch cms(static_cast<int>(depth), static_cast<int>(width));
+    for (auto& c : cms.counters)
+        c = SketchCodec::getU64(in, pos);
+    return cms;
+}
+
+size_t ProfileSketches::ingest(const uint64_t* userIds, const UserProfile* profiles, size_t count) {
+    const size_t BLOCK = 256;
+    uint64_t ids[BLOCK];
+    uint64_t cohorts[BLOCK];
+    uint64_t userHashes[BLOCK];
+    uint64_t rowHashes[16][BLOCK];
+    size_t rejected = 0;
+
+    for (size_t start = 0; start < count; start += BLOCK) {
+        size_t end = min(count, start + BLOCK);
+        size_t n = 0;
+        for (size_t i = start; i < end; i++) {
+            const UserProfile& p = profiles[i];
+            uint8_t activity = WellnessBot::encodeActivityLevel(p.activityLevel);
+            uint8_t diet = WellnessBot::encodeDietaryPref(p.dietaryPref);
+            uint8_t lifestyle = WellnessBot::encodeLifestyle(p.lifestyle);
+            if (activity == WellnessBot::ACTIVITY_COUNT || diet == WellnessBot::DIET_COUNT ||
+                lifestyle == WellnessBot::LIFESTYLE_COUNT) {
+                rejected++;
+                continue;
+            }
+            ids[n] = userIds[i];
+            cohorts[n++] = static_cast<uint64_t>(cohortKey(activity, diet, lifestyle));
+        }
+        ingestEncoded(ids, cohorts, n, userHashes, rowHashes);
+    }
+    return rejected;
+}
+
+vector<pair<int, uint64_t>> ProfileSketches::topCombinations(size_t k) const {
+    vector<pair<int, uint64_t>> all;
+    for (int c = 0; c < COHORT_COUNT; c++)
+        all.emplace_back(c, combinationCount(c));
+    stable_sort(all.begin(), all.end(),
+                [](const pair<int, uint64_t>& a, const pair<int, uint64_t>& b) {
+                    return a.second > b.second;
+                });
+    if (all.size() > k)
+        all.resize(k);
+    return all;
+}
+
+ProfileSketches ProfileSketches::deserialize(const string& in) {
+    size_t pos = 0;
+    SketchCodec::need(in, pos, 4);
+    if (in.compare(0, 4, "WBSK") != 0)
+        throw runtime_error("Not a profile sketch");
+    pos += 4;
+    if (SketchCodec::getU32(in, pos) != FORMAT_VERSION ||
+        SketchCodec::getU32(in, pos) != COHORT_COUNT)
+        throw runtime_error("Unsupported profile sketch version");
+
+    ProfileSketches sketches(4, 1, 1);
+    for (int c = 0; c < COHORT_COUNT; c++)
+        sketches.cohortUsers[c] = HyperLogLog::deserialize(in, pos);
+    sketches.frequencies = CountMinSketch::deserialize(in, pos);
+    return sketches;
+}
+
+void ProfileSketches::ingestEncoded(const uint64_t* userIds, const uint64_t* cohorts, size_t n,
+                                    uint64_t* userHashes, uint64_t (*rowHashes)[256]) {
+    SketchHash::hashBatch(userIds, n, USER_SEED, userHashes);
+    int rows = frequencies.rows();
+    for (int row = 0; row < rows; row++)
+        SketchHash::hashBatch(cohorts, n, CountMinSketch::ROW_SEED + row, rowHashes[row]);
+
+    uint64_t hashes[16];
+    for (size_t i = 0; i < n; i++) {
+        cohortUsers[cohorts[i]].addHash(userHashes[i]);
+        for (int row = 0; row < rows; row++)
+            hashes[row] = rowHashes[row][i];
+        frequencies.addHashes(hashes);
+    }
+}
+
+bool PackedProfile::pack(const UserProfile& profile, PackedProfile& packed) {
+    if (profile.age < WellnessBot::MIN_AGE || profile.age > WellnessBot::MAX_AGE ||
+        profile.sleepHours < WellnessBot::MIN_SLEEP_HOURS ||
+        profile.sleepHours > WellnessBot::MAX_SLEEP_HOURS)
+        return false;
+    return pack(static_cast<uint8_t>(profile.age), static_cast<uint8_t>(profile.sleepHours),
+                WellnessBot::encodeGender(profile.gender),
+                WellnessBot::encodeActivityLevel(profile.activityLevel),
+                WellnessBot::encodeLifestyle(profile.lifestyle),
+                WellnessBot::encodeDietaryPref(profile.dietaryPref),
+                WellnessBot::encodeGoal(profile.goal), profile.height, profile.weight,
+                profile.waist, profile.neck, profile.hip, packed);
+}
+
+bool PackedProfile::pack(uint8_t age, uint8_t sleepHours, uint8_t gender, uint8_t activityLevel,
+                         uint8_t lifestyle, uint8_t dietaryPref, uint8_t goal, double height, double weight,
+                         double waist, double neck, double hip, PackedProfile& packed) {
+    if (age < WellnessBot::MIN_AGE || age > WellnessBot::MAX_AGE ||
+        sleepHours > WellnessBot::MAX_SLEEP_HOURS || gender >= WellnessBot::GENDER_COUNT ||
+        activityLevel >= WellnessBot::ACTIVITY_COUNT || lifestyle >= WellnessBot::LIFESTYLE_COUNT ||
+        dietaryPref >= WellnessBot::DIET_COUNT || goal >= WellnessBot::GOAL_COUNT)
+        return false;
+    if (!(height >= WellnessBot::MIN_HEIGHT && height <= WellnessBot::MAX_HEIGHT) ||
+        !(weight >= WellnessBot::MIN_WEIGHT && weight <= WellnessBot::MAX_WEIGHT) ||
+        !circumferenceInRange(waist) || !circumferenceInRange(neck) || !circumferenceInRange(hip))
+        return false;
+    packed.height = quantize(height, HEIGHT_UNITS);
+    packed.weight = quantize(weight, WEIGHT_UNITS);
+    packed.waist = quantize(waist, CIRCUMFERENCE_UNITS);
+    packed.neck = quantize(neck, CIRCUMFERENCE_UNITS);
+    packed.hip = quantize(hip, CIRCUMFERENCE_UNITS);
+    packed.reserved = 0;
+    packed.codes = uint32_t(age) << AGE_SHIFT | uint32_t(sleepHours) << SLEEP_SHIFT |
+                   uint32_t(gender) << GENDER_SHIFT | uint32_t(activityLevel) << ACTIVITY_SHIFT |
+                   uint32_t(lifestyle) << LIFESTYLE_SHIFT | uint32_t(dietaryPref) << DIET_SHIFT |
+                   uint32_t(goal) << GOAL_SHIFT;
+    return true;
+}
+
+PackedProfile::UserProfile PackedProfile::unpack() const {
+    UserProfile profile;
+    profile.age = age();
+    profile.gender = WellnessBot::GENDER_NAMES[gender()];
+    profile.height = heightMeters();
+    profile.weight = weightKg();
+    profile.activityLevel = WellnessBot::ACTIVITY_NAMES[activityLevel()];
+    profile.sleepHours = sleepHours();
+    profile.lifestyle = WellnessBot::LIFESTYLE_NAMES[lifestyle()];
+    profile.dietaryPref = WellnessBot::DIET_NAMES[dietaryPref()];
+    profile.goal = WellnessBot::GOAL_NAMES[goal()];
+    profile.waist = waistCm();
+    profile.neck = neckCm();
+    profile.hip = hipCm();
+    return profile;
+}
+
+void ProfileColumns::resize(size_t rows) {
+    age.resize(rows);
+    sleepHours.resize(rows);
+    gender.resize(rows);
+    activityLevel.resize(rows);
+    lifestyle.resize(rows);
+    dietaryPref.resize(rows);
+    goal.resize(rows);
+    height.resize(rows);
+    weight.resize(rows);
+    waist.resize(rows);
+    neck.resize(rows);
+    hip.resize(rows);
+    bmi.resize(rows);
+    bmr.resize(rows);
+    dailyCalories.resize(rows);
+    bodyFatPercent.resize(rows);
+    leanBodyMass.resize(rows);
+    carbsGrams.resize(rows);
+    proteinGrams.resize(rows);
+    fatsGrams.resize(rows);
+}
+
+void ProfileColumns::set(size_t row, const UserProfile& profile) {
+    age[row] = static_cast<uint8_t>(profile.age);
+    sleepHours[row] = static_cast<uint8_t>(profile.sleepHours);
+    gender[row] = WellnessBot::encodeGender(profile.gender);
+    activityLevel[row] = WellnessBot::encodeActivityLevel(profile.activityLevel);
+    lifestyle[row] = WellnessBot::encodeLifestyle(profile.lifestyle);
+    dietaryPref[row] = WellnessBot::encodeDietaryPref(profile.dietaryPref);
+    goal[row] = WellnessBot::encodeGoal(profile.goal);
+    height[row] = profile.height;
+    weight[row] = profile.weight;
+    waist[row] = profile.waist;
+    neck[row] = profile.neck;
+    hip[row] = profile.hip;
+    bmi[row] = profile.bmi;
+    bmr[row] = profile.bmr;
+    dailyCalories[row] = profile.dailyCalories;
+    bodyFatPercent[row] = profile.bodyFatPercent;
+    leanBodyMass[row] = profile.leanBodyMass;
+}
+
+ProfileColumns::UserProfile ProfileColumns::row(size_t i) const {
+    UserProfile profile;
+    profile.age = age[i];
+    profile.gender = decode(WellnessBot::GENDER_NAMES, WellnessBot::GENDER_COUNT, gender[i]);
+    profile.height = height[i];
+    profile.weight = weight[i];
+    profile.activityLevel = decode(WellnessBot::ACTIVITY_NAMES, WellnessBot::ACTIVITY_COUNT,
+                                   activityLevel[i]);
+    profile.sleepHours = sleepHours[i];
+    profile.lifestyle = decode(WellnessBot::LIFESTYLE_NAMES, WellnessBot::LIFESTYLE_COUNT,
+                               lifestyle[i]);
+    profile.dietaryPref = decode(WellnessBot::DIET_NAMES, WellnessBot::DIET_COUNT, dietaryPref[i]);
+    profile.goal = decode(WellnessBot::GOAL_NAMES, WellnessBot::GOAL_COUNT, goal[i]);
+    profile.waist = waist[i];
+    profile.neck = neck[i];
+    profile.hip = hip[i];
+    profile.bmi = bmi[i];
+    profile.bmr = bmr[i];
+    profile.dailyCalories = dailyCalories[i];
+    profile.bodyFatPercent = bodyFatPercent[i];
+    profile.leanBodyMass = leanBodyMass[i];
+    return profile;
+}
+
+void ProfileColumns::unpack(size_t first, const PackedProfile* packed, size_t count) {
+    size_t i = 0;
+#ifdef __AVX2__
+    // Four profiles at a time: 16-bit fields are widened and transposed so
+    // each field lands in one vector, and codes are split out with shifts
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    const __m256d heightUnits = _mm256_set1_pd(PackedProfile::HEIGHT_UNITS);
+    const __m256d weightUnits = _mm256_set1_pd(PackedProfile::WEIGHT_UNITS);
+    const __m256d circumferenceUnits = _mm256_set1_pd(PackedProfile::CIRCUMFERENCE_UNITS);
+    for (; i + 4 <= count; i += 4) {
+        size_t row = first + i;
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(packed + i));      // p0 | p1
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(packed + i + 2));  // p2 | p3
+        // Per profile: height weight waist neck, as 32-bit values
+        __m256i lengthsA = _mm256_unpacklo_epi16(a, zero);
+        __m256i lengthsB = _mm256_unpacklo_epi16(b, zero);
+        // height x4 | weight x4, then waist x4 | neck x4
+        __m256i heightWeight = _mm256_permutevar8x32_epi32(_mm256_unpacklo_epi32(lengthsA, lengthsB), order);
+        __m256i waistNeck = _mm256_permutevar8x32_epi32(_mm256_unpackhi_epi32(lengthsA, lengthsB), order);
+        // hip and reserved x4 | codes x4
+        __m256i hipCodes = _mm256_permutevar8x32_epi32(_mm256_unpackhi_epi32(a, b), order);
+
+        _mm256_storeu_pd(&height[row], _mm256_div_pd(
+            _mm256_cvtepi32_pd(_mm256_castsi256_si128(heightWeight)), heightUnits));
+        _mm256_storeu_pd(&weight[row], _mm256_div_pd(
+            _mm256_cvtepi32_pd(_mm256_extracti128_si256(heightWeight, 1)), weightUnits));
+        _mm256_storeu_pd(&waist[row], _mm256_div_pd(
+            _mm256_cvtepi32_pd(_mm256_castsi256_si128(waistNeck)), circumferenceUnits));
+        _mm256_storeu_pd(&neck[row], _mm256_div_pd(
+            _mm256_cvtepi32_pd(_mm256_extracti128_si256(waistNeck, 1)), circumferenceUnits));
+        __m128i hipUnits = _mm_and_si128(_mm256_castsi256_si128(hipCodes), _mm_set1_epi32(0xffff));
+        _mm256_storeu_pd(&hip[row], _mm256_div_pd(_mm256_cvtepi32_pd(hipUnits), circumferenceUnits));
+
+        __m128i codes = _mm256_extracti128_si256(hipCodes, 1);
+        storeField(codes, PackedProfile::AGE_SHIFT, PackedProfile::AGE_MASK, &age[row]);
+        storeField(codes, PackedProfile::SLEEP_SHIFT, PackedProfile::SLEEP_MASK, &sleepHours[row]);
+        storeField(codes, PackedProfile::GENDER_SHIFT, PackedProfile::GENDER_MASK, &gender[row]);
+        storeField(codes, PackedProfile::ACTIVITY_SHIFT, PackedProfile::CODE_MASK, &activityLevel[row]);
+        storeField(codes, PackedProfile::LIFESTYLE_SHIFT, PackedProfile::CODE_MASK, &lifestyle[row]);
+        storeField(codes, PackedProfile::DIET_SHIFT, PackedProfile::CODE_MASK, &dietaryPref[row]);
+        storeField(codes, PackedProfile::GOAL_SHIFT, PackedProfile::CODE_MASK, &goal[row]);
+    }
+#endif
+    for (; i < count; i++) {
+        const PackedProfile& p = packed[i];
+        size_t row = first + i;
+        age[row] = p.age();
+        sleepHours[row] = p.sleepHours();
+        gender[row] = p.gender();
+        activityLevel[row] = p.activityLevel();
+        lifestyle[row] = p.lifestyle();
+        dietaryPref[row] = p.dietaryPref();
+        goal[row] = p.goal();
+        height[row] = p.heightMeters();
+        weight[row] = p.weightKg();
+        waist[row] = p.waistCm();
+        neck[row] = p.neckCm();
+        hip[row] = p.hipCm();
+    }
+}
+
+void ProfileColumns::calculateMetrics(const WellnessBot::WellnessConfig& cfg, const MetricsView& v,
+                                      size_t begin, size_t end) {
+    double multipliers[WellnessBot::ACTIVITY_COUNT + 1];
+    for (uint8_t a = 0; a < WellnessBot::ACTIVITY_COUNT; a++)
+        multipliers[a] = cfg.activityMultipliers[a];
+    multipliers[WellnessBot::ACTIVITY_COUNT] = numeric_limits<double>::quiet_NaN();
+
+    bool katch = cfg.bmrFormula == WellnessBot::BMR_KATCH_MCARDLE;
+
+    // Both formulas are evaluated and selected per row, so the loop has no
+    // data-dependent branches
+    for (size_t i = begin; i < end; i++) {
+        double h = v.height[i];
+        double w = v.weight[i];
+        bool male = v.gender[i] == WellnessBot::GENDER_MALE;
+        double rowBmi = w / (h * h);
+        v.bmi[i] = rowBmi;
+
+        double navy = WellnessBot::navyBodyFat(male, h * 100, v.waist[i], v.neck[i], v.hip[i]);
+        double deurenberg = WellnessBot::deurenbergBodyFat(male, rowBmi, v.age[i]);
+        double fat = WellnessBot::hasCircumferences(male, v.waist[i], v.neck[i], v.hip[i]) ? navy : deurenberg;
+        fat = min(WellnessBot::MAX_BODY_FAT_PERCENT, max(WellnessBot::MIN_BODY_FAT_PERCENT, fat));
+        double lean = w * (1.0 - fat / 100.0);
+        v.bodyFatPercent[i] = fat;
+        v.leanBodyMass[i] = lean;
+
+        double maleBmr = WellnessBot::basalMetabolicRate(true, w, h, v.age[i]);
+        double femaleBmr = WellnessBot::basalMetabolicRate(false, w, h, v.age[i]);
+        double standard = male ? maleBmr : femaleBmr;
+        double rowBmr = katch ? WellnessBot::katchMcArdle(lean) : standard;
+        v.bmr[i] = rowBmr;
+        v.dailyCalories[i] = rowBmr * multipliers[min<uint8_t>(v.activityLevel[i], WellnessBot::ACTIVITY_COUNT)];
+    }
+}
+
+void ProfileColumns::calculateMacros(const WellnessBot::WellnessConfig& cfg, size_t begin, size_t end) {
+    const WellnessBot::MacroProfile* profiles = cfg.macroProfiles.data();
+    for (size_t i = begin; i < end; i++) {
+        size_t index = WellnessBot::macroProfileIndex(
+            min<uint8_t>(dietaryPref[i], WellnessBot::DIET_COUNT - 1),
+            min<uint8_t>(activityLevel[i], WellnessBot::ACTIVITY_COUNT - 1),
+            min<uint8_t>(goal[i], WellnessBot::GOAL_COUNT - 1));
+        WellnessBot::MacroGrams grams =
+            WellnessBot::macroGrams(profiles[index], dailyCalories[i], weight[i]);
+        carbsGrams[i] = grams.carbs;
+        proteinGrams[i] = grams.protein;
+        fatsGrams[i] = grams.fats;
+    }
+}
+
+void RecommendationMasks::count(const uint32_t* masks, size_t n, Counts& counts) {
+    static const array<uint64_t, 256> spread = [] {
+        array<uint64_t, 256> table{};
+        for (int byte = 0; byte < 256; byte++) {
+            for (int bit = 0; bit < 8; bit++)
+                table[byte] |= static_cast<uint64_t>((byte >> bit) & 1) << (8 * bit);
+        }
+        return table;
+    }();
+    const int BYTES = (WellnessBot::RECOMMENDATION_COUNT + 7) / 8;
+    const size_t FLUSH_ROWS = 255;
+    for (size_t first = 0; first < n; first += FLUSH_ROWS) {
+        size_t last = min(n, first + FLUSH_ROWS);
+        uint64_t lanes[BYTES] = {};
+        for (size_t i = first; i < last; i++) {
+            for (int b = 0; b < BYTES; b++)
+                lanes[b] += spread[(masks[i] >> (8 * b)) & 0xFF];
+        }
+        for (int bit = 0; bit < WellnessBot::RECOMMENDATION_COUNT; bit++)
+            counts[bit] += (lanes[bit / 8] >> (8 * (bit % 8))) & 0xFF;
+    }
+}
+
+void RecommendationMasks::select(const uint32_t* masks, size_t n, uint32_t required, uint32_t excluded,
+                                 vector<uint32_t>& rows) {
+    rows.resize(n);
+    size_t matches = 0;
+    for (size_t i = 0; i < n; i++) {
+        rows[matches] = static_cast<uint32_t>(i);
+        matches += (masks[i] & (required | excluded)) == required;
+    }
+    rows.resize(matches);
+}
+
+double GoalPlanner::advanceWeek(double& weight, double target, double maintenance, double minIntake) {
+    double perWeek = CALORIES_PER_KG / 7.0;
+    double deficit = min(min(MAX_DEFICIT_FRACTION * maintenance,
+                             MAX_WEEKLY_LOSS_FRACTION * weight * perWeek),
+                         min((weight - target) * perWeek, maintenance - minIntake));
+    double surplus = min(min(MAX_SURPLUS_FRACTION * maintenance,
+                             MAX_WEEKLY_GAIN_FRACTION * weight * perWeek),
+                         (target - weight) * perWeek);
+    deficit = max(0.0, deficit);
+    surplus = max(0.0, surplus);
+    weight += (surplus - deficit) / perWeek;
+    return maintenance - deficit + surplus;
+}
+
+GoalPlanner::GoalPlan GoalPlanner::plan(const UserProfile& profile, const WellnessConfig& cfg,
+                                        double targetBmi) {
+    GoalPlan result;
+    result.targetBmi = targetBmi;
+    result.targetWeight = targetWeight(targetBmi, profile.height);
+    result.reachable = true;
+
+    uint8_t activity = WellnessBot::encodeActivityLevel(profile.activityLevel);
+    if (activity >= WellnessBot::ACTIVITY_COUNT)
+        throw invalid_argument("unknown activity level " + profile.activityLevel);
+    bool male = profile.gender == "male";
+    double multiplier = cfg.activityMultipliers[activity];
+    double intakeFloor = minIntake(male, profile.age);
+
+    double weight = profile.weight;
+    for (int week = 1; abs(weight - result.targetWeight) > TOLERANCE_KG; week++) {
+        if (week > MAX_WEEKS) {
+            result.reachable = false;
+            break;
+        }
+        PlanWeek entry;
+        entry.week = week;
+        entry.weight = weight;
+        entry.maintenance = maintenance(cfg, male, weight, profile.height, profile.age,
+                                        profile.bmr, multiplier);
+        entry.intake = advanceWeek(weight, result.targetWeight, entry.maintenance, intakeFloor);
+        if (weight == entry.weight) {
+            result.reachable = false;
+            break;
+        }
+        result.weeks.push_back(entry);
+    }
+    return result;
+}
+
+void GoalPlanner::printPlan(const GoalPlan& plan, const WellnessBot::MessageCatalog& catalog, ostream& out) {
+    out << "\n";
+    catalog.write(out, WellnessBot::MSG_PLAN_TITLE);
+    out << "\n";
+    catalog.write(out, WellnessBot::MSG_PLAN_TARGET,
+                  {WellnessBot::formatNumber(plan.targetBmi, 2, catalog),
+                   WellnessBot::formatNumber(plan.targetWeight, 2, catalog)});
+    out << "\n";
+    if (!plan.reachable) {
+        catalog.write(out, WellnessBot::MSG_PLAN_UNREACHABLE);
+        out << "\n";
+        return;
+    }
+    catalog.write(out, WellnessBot::MSG_PLAN_WEEKS,
+                  {WellnessBot::formatNumber(static_cast<int>(plan.weeks.size()), catalog)});
+    out << "\n";
+    for (size_t i = 0; i < plan.weeks.size(); i++) {
+        if (i % PRINTED_WEEK_STEP != 0 && i + 1 != plan.weeks.size())
+            continue;
+        const PlanWeek& week = plan.weeks[i];
+        out << "  ";
+        catalog.write(out, WellnessBot::MSG_PLAN_WEEK,
+                      {WellnessBot::formatNumber(week.week, catalog),
+                       WellnessBot::formatNumber(week.weight, 2, catalog),
+                       WellnessBot::formatNumber(week.intake, 2, catalog),
+                       WellnessBot::formatNumber(week.maintenance, 2, catalog)});
+        out << "\n";
+    }
+}
+
+uint16_t GoalPlanner::weeksToTarget(double weight, double target, double alpha, double beta,
+                                    double minIntake) {
+    const double perWeek = CALORIES_PER_KG / 7.0;
+    if (abs(target - weight) <= TOLERANCE_KG)
+        return 0;
+    if (!(alpha * weight + beta > 0.0))
+        return UNREACHABLE;  // no valid maintenance estimate
+    bool losing = weight > target;
+    double dir = losing ? -1.0 : 1.0;
+    // Rate bounds in calories/day as a[j] * weight + b[j]; the last one is
+    // the distance left, which binds only in the final week
+    double a[4], b[4];
+    if (losing) {
+        a[0] = MAX_DEFICIT_FRACTION * alpha, b[0] = MAX_DEFICIT_FRACTION * beta;
+        a[1] = MAX_WEEKLY_LOSS_FRACTION * perWeek, b[1] = 0.0;
+        a[2] = alpha, b[2] = beta - minIntake;
+    } else {
+        a[0] = MAX_SURPLUS_FRACTION * alpha, b[0] = MAX_SURPLUS_FRACTION * beta;
+        a[1] = MAX_WEEKLY_GAIN_FRACTION * perWeek, b[1] = 0.0;
+        a[2] = 0.0, b[2] = numeric_limits<double>::infinity();
+    }
+    a[3] = -dir * perWeek, b[3] = dir * perWeek * target;
+
+    int weeks = 0;
+    while (weeks <= MAX_WEEKS) {
+        if ((target - weight) * dir <= TOLERANCE_KG)
+            return static_cast<uint16_t>(weeks);
+        int k = 0;
+        for (int n = 1; n < 3; n++) {
+            if (a[n] * weight + b[n] < a[k] * weight + b[k])
+                k = n;
+        }
+        double rate = a[k] * weight + b[k];
+        if (rate <= 0.0)
+            return UNREACHABLE;
+        if (a[3] * weight + b[3] <= rate)
+            return weeks + 1 > MAX_WEEKS ? UNREACHABLE : static_cast<uint16_t>(weeks + 1);
+
+        // Nearest weight ahead where another line drops below bound k, or
+        // where the plan is within tolerance of the target
+        double boundary = target - dir * TOLERANCE_KG;
+        for (int n = 0; n < 4; n++) {
+            if (n == k || (a[n] - a[k]) * dir >= 0.0)
+                continue;
+            double x = (b[k] - b[n]) / (a[n] - a[k]);
+            if ((x - weight) * dir > 0.0 && (x - boundary) * dir < 0.0)
+                boundary = x;
+        }
+
+        // Weeks until weight passes the boundary
+        double steps;
+        double r = 1.0 + dir * a[k] / perWeek;
+        double fixed = a[k] != 0.0 ? -b[k] / a[k] : 0.0;
+        if (a[k] == 0.0) {
+            steps = ceil((boundary - weight) * dir * perWeek / b[k]);
+        } else {
+            double ratio = (boundary - fixed) / (weight - fixed);
+            if (ratio <= 0.0)
+                return UNREACHABLE;  // rate reaches zero first
+            steps = ceil(log(ratio) / log(r));
+        }
+        steps = max(1.0, steps);
+        if (steps > MAX_WEEKS - weeks)
+            return UNREACHABLE;
+        auto after = [&](double n) {
+            return a[k] == 0.0 ? weight + dir * n * b[k] / perWeek
+                               : fixed + pow(r, n) * (weight - fixed);
+        };
+        // Correct rounding in the log ratio so the step count is exact
+        if (steps > 1.0 && (after(steps - 1.0) - boundary) * dir > 0.0)
+            steps -= 1.0;
+        else if ((after(steps) - boundary) * dir <= 0.0)
+            steps += 1.0;
+        weight = after(steps);
+        weeks += static_cast<int>(steps);
+    }
+    return UNREACHABLE;
+}
+
+void GoalPlanner::planBatch(const ProfileColumns& columns, const WellnessConfig& cfg, size_t begin,
+                            size_t end, GoalPlans& plans) {
+    double multipliers[WellnessBot::ACTIVITY_COUNT + 1];
+    for (uint8_t a = 0; a < WellnessBot::ACTIVITY_COUNT; a++)
+        multipliers[a] = cfg.activityMultipliers[a];
+    multipliers[WellnessBot::ACTIVITY_COUNT] = numeric_limits<double>::quiet_NaN();
+
+    bool katch = cfg.bmrFormula == WellnessBot::BMR_KATCH_MCARDLE;
+    for (size_t i = begin; i < end; i++) {
+        bool male = columns.gender[i] == WellnessBot::GENDER_MALE;
+        double multiplier = multipliers[min<uint8_t>(columns.activityLevel[i], WellnessBot::ACTIVITY_COUNT)];
+        double height = columns.height[i];
+        double intakeFloor = minIntake(male, columns.age[i]);
+
+        // Maintenance as an affine function of weight
+        double base = WellnessBot::basalMetabolicRate(male, 0.0, height, columns.age[i]);
+        double slope = WellnessBot::basalMetabolicRate(male, 1.0, height, columns.age[i]) - base;
+        double alpha = katch ? 0.0 : slope * multiplier;
+        double beta = (katch ? columns.bmr[i] : base) * multiplier;
+
+        double weight = columns.weight[i];
+        double target = targetWeight(targetBmi(columns.bmi[i], cfg), height);
+        plans.targetWeight[i] = target;
+        plans.weeks[i] = weeksToTarget(weight, target, alpha, beta, intakeFloor);
+        plans.startIntake[i] = plans.weeks[i] == 0
+                                   ? columns.dailyCalories[i]
+                                   : advanceWeek(weight, target, alpha * weight + beta, intakeFloor);
+    }
+}
+
+void ZoneMaps::build(const ProfileColumns& columns) {
+    zones.assign(columns.blockCount(), Zone());
+    for (size_t b = 0; b < zones.size(); b++) {
+        size_t begin = b * ProfileColumns::BLOCK_ROWS;
+        size_t end = min(columns.size(), begin + ProfileColumns::BLOCK_ROWS);
+        Zone& z = zones[b];
+        z.minAge = 255;
+        z.maxAge = 0;
+        z.minBmi = z.minHeight = z.minWeight = numeric_limits<double>::infinity();
+        z.maxBmi = z.maxHeight = z.maxWeight = -numeric_limits<double>::infinity();
+        for (size_t i = begin; i < end; i++) {
+            z.minAge = min(z.minAge, columns.age[i]);
+            z.maxAge = max(z.maxAge, columns.age[i]);
+            z.minBmi = min(z.minBmi, columns.bmi[i]);
+            z.maxBmi = max(z.maxBmi, columns.bmi[i]);
+            z.minHeight = min(z.minHeight, columns.height[i]);
+            z.maxHeight = max(z.maxHeight, columns.height[i]);
+            z.minWeight = min(z.minWeight, columns.weight[i]);
+            z.maxWeight = max(z.maxWeight, columns.weight[i]);
+        }
+    }
+}
+
+vector<uint32_t> ZoneMaps::select(const ProfileColumns& columns, const RangeQuery& q) const {
+    vector<uint32_t> rows;
+    for (size_t b = 0; b < zones.size(); b++) {
+        if (!mayMatch(b, q))
+            continue;
+        size_t begin = b * ProfileColumns::BLOCK_ROWS;
+        size_t end = min(columns.size(), begin + ProfileColumns::BLOCK_ROWS);
+        for (size_t i = begin; i < end; i++) {
+            if (q.matches(columns, i))
+                rows.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    return rows;
+}
+
+EliasFano::EliasFano(const vector<uint32_t>& sorted, uint64_t universe) : count(sorted.size()) {
+    if (count == 0)
+        return;
+    lowBits = 0;
+    while (lowBits < 32 && (uint64_t(count) << (lowBits + 1)) <= universe)
+        lowBits++;
+    lower.assign((count * lowBits + 63) / 64 + 1, 0);
+    upper.assign((count + (universe >> lowBits) + 1 + 63) / 64, 0);
+
+    uint64_t lowMask = (uint64_t(1) << lowBits) - 1;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t value = sorted[i];
+        if (lowBits > 0) {
+            size_t bit = i * lowBits;
+            lower[bit / 64] |= (value & lowMask) << (bit % 64);
+            if (bit % 64 + lowBits > 64)
+                lower[bit / 64 + 1] |= (value & lowMask) >> (64 - bit % 64);
+        }
+        size_t high = (value >> lowBits) + i;
+        upper[high / 64] |= uint64_t(1) << (high % 64);
+    }
+}
+
+void BandIndex::build(const ProfileColumns& columns) {
+    vector<vector<uint32_t>> ageRows(AGE_BANDS), bmiRows(BMI_BANDS);
+    for (size_t i = 0; i < columns.size(); i++) {
+        ageRows[ageBand(columns.age[i])].push_back(static_cast<uint32_t>(i));
+        bmiRows[bmiBand(columns.bmi[i])].push_back(static_cast<uint32_t>(i));
+    }
+    agePostings.clear();
+    bmiPostings.clear();
+    for (const auto& rows : ageRows)
+        agePostings.emplace_back(rows, columns.size());
+    for (const auto& rows : bmiRows)
+        bmiPostings.emplace_back(rows, columns.size());
+}
+
+vector<uint32_t> BandIndex::select(const ProfileColumns& columns, const RangeQuery& q) const {
+    int ageLow = ageBand(max(0, q.minAge));
+    int ageHigh = ageBand(min(255, q.maxAge));
+    int bmiLow = bmiBand(q.minBmi);
+    int bmiHigh = bmiBand(q.maxBmi);
+
+    size_t ageCandidates = 0, bmiCandidates = 0;
+    for (int b = ageLow; b <= ageHigh; b++)
+        ageCandidates += agePostings[b].size();
+    for (int b = bmiLow; b <= bmiHigh; b++)
+        bmiCandidates += bmiPostings[b].size();
+
+    vector<uint32_t> rows;
+    vector<uint32_t> candidateRows = ageCandidates <= bmiCandidates
+                                         ? candidates(agePostings, ageLow, ageHigh)
+                                         : candidates(bmiPostings, bmiLow, bmiHigh);
+    for (uint32_t row : candidateRows) {
+        if (q.matches(columns, row))
+            rows.push_back(row);
+    }
+    return rows;
+}
+
+vector<uint32_t> BandIndex::candidates(const vector<EliasFano>& postings, int low, int high) {
+    vector<uint32_t> rows;
+    for (int b = low; b <= high; b++) {
+        size_t mid = rows.size();
+        postings[b].forEach([&](uint32_t row) { rows.push_back(row); });
+        if (mid != 0)
+            inplace_merge(rows.begin(), rows.begin() + mid, rows.end());
+    }
+    return rows;
+}
+
+NumaTopology NumaTopology::detect() {
+    NumaTopology topology;
+    cpu_set_t allowed;
+    bool restricted = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+    auto isAllowed = [&](int c) {
+        return !restricted || (c >= 0 && c < CPU_SETSIZE && CPU_ISSET(c, &allowed));
+    };
+    DIR* dir = opendir("/sys/devices/system/node");
+    if (dir) {
+        while (dirent* entry = readdir(dir)) {
+            int id;
+            char extra;
+            if (sscanf(entry->d_name, "node%d%c", &id, &extra) != 1)
+                continue;
+            ifstream cpulist("/sys/devices/system/node/" + string(entry->d_name) + "/cpulist");
+            string text;
+            getline(cpulist, text);
+            vector<int> cpus = parseCpuList(text);
+            cpus.erase(remove_if(cpus.begin(), cpus.end(), [&](int c) { return !isAllowed(c); }),
+                       cpus.end());
+            if (!cpus.empty())
+                topology.nodes.push_back({id, cpus});
+        }
+        closedir(dir);
+    }
+    sort(topology.nodes.begin(), topology.nodes.end(),
+         [](const Node& a, const Node& b) { return a.id < b.id; });
+    if (topology.nodes.empty()) {
+        Node node = {0, {}};
+        if (restricted) {
+            for (int c = 0; c < CPU_SETSIZE; c++) {
+                if (CPU_ISSET(c, &allowed))
+                    node.cpus.push_back(c);
+            }
+        }
+        if (node.cpus.empty()) {
+            for (unsigned c = 0; c < max(1u, thread::hardware_concurrency()); c++)
+                node.cpus.push_back(static_cast<int>(c));
+        }
+        topology.nodes.push_back(node);
+    }
+    return topology;
+}
+
+vector<int> NumaTopology::parseCpuList(const string& text) {
+    vector<int> cpus;
+    stringstream ranges(text);
+    string range;
+    while (getline(ranges, range, ',')) {
+        int first, last;
+        int fields = sscanf(range.c_str(), "%d-%d", &first, &last);
+        if (fields == 1)
+            last = first;
+        else if (fields != 2)
+            continue;
+        for (int c = first; c <= last; c++)
+            cpus.push_back(c);
+    }
+    return cpus;
+}
+
+bool NumaTopology::bindMemory(void* addr, size_t len, int node) {
+    const int MPOL_PREFERRED = 1;
+    const unsigned MPOL_MF_MOVE = 1 << 1;
+    uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t begin = (reinterpret_cast<uintptr_t>(addr) + page - 1) & ~(page - 1);
+    uintptr_t end = (reinterpret_cast<uintptr_t>(addr) + len) & ~(page - 1);
+    if (end <= begin)
+        return true;
+    unsigned long mask[16] = {};
+    if (node < 0 || node >= static_cast<int>(sizeof(mask) * 8))
+        return false;
+    mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+    return syscall(SYS_mbind, begin, end - begin, MPOL_PREFERRED, mask, sizeof(mask) * 8,
+                   MPOL_MF_MOVE) == 0;
+}
+
+NumaWorkerPool::NumaWorkerPool(const NumaTopology& topology, unsigned threadsPerNode) : topology(topology) {
+    for (size_t n = 0; n < topology.nodes.size(); n++) {
+        unsigned count = threadsPerNode ? threadsPerNode
+                                        : static_cast<unsigned>(topology.nodes[n].cpus.size());
+        nodeThreads.push_back(count);
+    }
+    unique_lock<mutex> lock(poolMutex);
+    pending = accumulate(nodeThreads.begin(), nodeThreads.end(), 0u);
+    for (size_t n = 0; n < nodeThreads.size(); n++) {
+        for (unsigned i = 0; i < nodeThreads[n]; i++)
+            workers.emplace_back(&NumaWorkerPool::workerLoop, this, n, i, nodeThreads[n]);
+    }
+    done.wait(lock, [&]() { return pending == 0; });
+    if (unpinned > 0) {
+        cerr << "Warning: " << unpinned << " of " << workers.size()
+             << " workers could not be pinned to their NUMA node's CPUs (" << strerror(pinError)
+             << "); running them unpinned" << endl;
+    }
+}
+
+NumaWorkerPool::~NumaWorkerPool() {
+    {
+        lock_guard<mutex> lock(poolMutex);
+        stopping = true;
+        generation++;
+    }
+    wake.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void NumaWorkerPool::run(const Task& task) {
+    unique_lock<mutex> lock(poolMutex);
+    current = &task;
+    pending = threadCount();
+    failure = nullptr;
+    generation++;
+    wake.notify_all();
+    done.wait(lock, [&]() { return pending == 0; });
+    current = nullptr;
+    if (failure)
+        rethrow_exception(failure);
+}
+
+pair<size_t, size_t> NumaWorkerPool::nodeRange(size_t node, size_t rows) const {
+    size_t blocks = (rows + ProfileColumns::BLOCK_ROWS - 1) / ProfileColumns::BLOCK_ROWS;
+    size_t before = 0;
+    for (size_t n = 0; n < node; n++)
+        before += nodeThreads[n];
+    size_t firstBlock = blocks * before / threadCount();
+    size_t lastBlock = blocks * (before + nodeThreads[node]) / threadCount();
+    return {min(rows, firstBlock * ProfileColumns::BLOCK_ROWS),
+            min(rows, lastBlock * ProfileColumns::BLOCK_ROWS)};
+}
+
+void NumaWorkerPool::workerLoop(size_t node, unsigned index, unsigned count) {
+    int error = NumaTopology::pinCurrentThread(topology.nodes[node].cpus);
+    {
+        lock_guard<mutex> lock(poolMutex);
+        if (error != 0) {
+            unpinned++;
+            pinError = error;
+        }
+        if (--pending == 0)
+            done.notify_one();
+    }
+    uint64_t seen = 0;
+    while (true) {
+        const Task* task;
+        {
+            unique_lock<mutex> lock(poolMutex);
+            wake.wait(lock, [&]() { return generation != seen; });
+            seen = generation;
+            if (stopping)
+                return;
+            task = current;
+        }
+        exception_ptr error;
+        try {
+            (*task)(node, index, count);
+        } catch (...) {
+            error = current_exception();
+        }
+        lock_guard<mutex> lock(poolMutex);
+        if (error && !failure)
+            failure = error;
+        if (--pending == 0)
+            done.notify_one();
+    }
+}
+
+bool NumaBatch::placeColumns(ProfileColumns& columns, const NumaWorkerPool& pool,
+                             const NumaTopology& topology) {
+    bool ok = true;
+    for (size_t n = 0; n < pool.nodeCount(); n++) {
+        pair<size_t, size_t> range = pool.nodeRange(n, columns.size());
+        int node = topology.nodes[n].id;
+        ok &= bindRows(columns.age, range, node);
+        ok &= bindRows(columns.sleepHours, range, node);
+        ok &= bindRows(columns.gender, range, node);
+        ok &= bindRows(columns.activityLevel, range, node);
+        ok &= bindRows(columns.lifestyle, range, node);
+        ok &= bindRows(columns.dietaryPref, range, node);
+        ok &= bindRows(columns.goal, range, node);
+        ok &= bindRows(columns.height, range, node);
+        ok &= bindRows(columns.weight, range, node);
+        ok &= bindRows(columns.waist, range, node);
+        ok &= bindRows(columns.neck, range, node);
+        ok &= bindRows(columns.hip, range, node);
+        ok &= bindRows(columns.bmi, range, node);
+        ok &= bindRows(columns.bmr, range, node);
+        ok &= bindRows(columns.dailyCalories, range, node);
+        ok &= bindRows(columns.bodyFatPercent, range, node);
+        ok &= bindRows(columns.leanBodyMass, range, node);
+        ok &= bindRows(columns.carbsGrams, range, node);
+        ok &= bindRows(columns.proteinGrams, range, node);
+        ok &= bindRows(columns.fatsGrams, range, node);
+    }
+    return ok;
+}
+
+CohortViews::Snapshot NumaBatch::aggregate(const WellnessBot& bot, const ProfileColumns& columns,
+                                           NumaWorkerPool& pool) {
+    const WellnessBot::WellnessConfig& cfg = bot.config();
+    const WellnessBot::GrowthChart* chart = bot.growthChart();
+    vector<unique_ptr<CohortViews::Snapshot>> partials(pool.threadCount());
+    vector<size_t> firstSlot;
+    for (size_t n = 0, slot = 0; n < pool.nodeCount(); slot += pool.threadsOn(n), n++)
+        firstSlot.push_back(slot);
+
+    pool.run([&](size_t node, unsigned index, unsigned) {
+        // Allocated and first touched by the worker, so it lives on its node
+        unique_ptr<CohortViews::Snapshot> local(new CohortViews::Snapshot());
+        pair<size_t, size_t> range = pool.threadRange(node, index, columns.size());
+        for (size_t i = range.first; i < range.second; i++) {
+            local->addEncoded(cfg, chart, columns.age[i], columns.gender[i], columns.activityLevel[i],
+                              columns.dietaryPref[i], columns.bmi[i], columns.dailyCalories[i]);
+        }
+        partials[firstSlot[node] + index] = move(local);
+    });
+
+    CohortViews::Snapshot total;
+    for (const auto& local : partials)
+        total.merge(*local);
+    return total;
+}
+
+FeatureSpace FeatureSpace::fit(const ProfileColumns& columns, NumaWorkerPool& pool,
+                               const Features& features) {
+    FeatureSpace space;
+    space.features = features;
+    struct Moments {
+        double count = 0;
+        array<double, DIMENSIONS> mean{}, m2{};
+    };
+    vector<Moments> partials(pool.threadCount());
+
+    pool.run([&](size_t node, unsigned index, unsigned) {
+        Moments local;
+        pair<size_t, size_t> range = pool.threadRange(node, index, columns.size());
+        for (size_t i = range.first; i < range.second; i++) {
+            double raw[DIMENSIONS];
+            space.rawFeatures(columns, i, raw);
+            local.count++;
+            for (int d = 0; d < DIMENSIONS; d++) {
+                double delta = raw[d] - local.mean[d];
+                local.mean[d] += delta / local.count;
+                local.m2[d] += delta * (raw[d] - local.mean[d]);
+            }
+        }
+        partials[pool.slot(node, index)] = local;
+    });
+
+    Moments total;
+    for (const Moments& part : partials) {
+        if (part.count == 0)
+            continue;
+        double count = total.count + part.count;
+        for (int d = 0; d < DIMENSIONS; d++) {
+            double delta = part.mean[d] - total.mean[d];
+            total.mean[d] += delta * part.count / count;
+            total.m2[d] += part.m2[d] + delta * delta * total.count * part.count / count;
+        }
+        total.count = count;
+    }
+
+    for (int d = 0; d < DIMENSIONS; d++) {
+        double deviation = total.count > 0 ? sqrt(total.m2[d] / total.count) : 0;
+        space.mean[d] = total.mean[d];
+        space.scale[d] = deviation > 0 ? 1 / deviation : 1;
+    }
+    return space;
+}
+
+void FeatureSpace::squaredDistances(const Point* points, size_t count, const Point& query, float* out) {
+    size_t i = 0;
+#ifdef __AVX2__
+    __m256 q = _mm256_loadu_ps(query.f);
+    for (; i + 8 <= count; i += 8) {
+        auto square = [&](size_t r) {
+            __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(points[i + r].f), q);
+            return _mm256_mul_ps(diff, diff);
+        };
+        // Horizontal sums of eight points at once: after two rounds of
+        // hadd each 128-bit lane holds four points' partial sums over
+        // features 0-3 (low lane) or 4-7 (high lane)
+        __m256 s0123 = _mm256_hadd_ps(_mm256_hadd_ps(square(0), square(1)),
+                                      _mm256_hadd_ps(square(2), square(3)));
+        __m256 s4567 = _mm256_hadd_ps(_mm256_hadd_ps(square(4), square(5)),
+                                      _mm256_hadd_ps(square(6), square(7)));
+        __m256 low = _mm256_permute2f128_ps(s0123, s4567, 0x20);
+        __m256 high = _mm256_permute2f128_ps(s0123, s4567, 0x31);
+        _mm256_storeu_ps(out + i, _mm256_add_ps(low, high));
+    }
+#endif
+    for (; i < count; i++)
+        out[i] = squaredDistance(points[i], query);
+}
+
+size_t FeatureSpace::nearest(const Point* centers, size_t count, const Point& point) {
+    const size_t CHUNK = 256;
+    float distances[CHUNK];
+    size_t best = 0;
+    float bestDistance = numeric_limits<float>::infinity();
+    for (size_t begin = 0; begin < count; begin += CHUNK) {
+        size_t n = min(CHUNK, count - begin);
+        squaredDistances(centers + begin, n, point, distances);
+        for (size_t i = 0; i < n; i++) {
+            if (distances[i] < bestDistance) {
+                bestDistance = distances[i];
+                best = begin + i;
+            }
+        }
+    }
+    return best;
+}
+
+double FeatureSpace::value(const ProfileColumns& columns, size_t i, Feature feature) {
+    switch (feature) {
+        case FEATURE_AGE: return columns.age[i];
+        case FEATURE_GENDER: return columns.gender[i];
+        case FEATURE_HEIGHT: return columns.height[i];
+        case FEATURE_WEIGHT: return columns.weight[i];
+        case FEATURE_BMI: return columns.bmi[i];
+        case FEATURE_BMR: return columns.bmr[i];
+        case FEATURE_DAILY_CALORIES: return columns.dailyCalories[i];
+        case FEATURE_ACTIVITY: return columns.activityLevel[i];
+        case FEATURE_SLEEP: return columns.sleepHours[i];
+        case FEATURE_LIFESTYLE: return columns.lifestyle[i];
+        case FEATURE_DIET: return columns.dietaryPref[i];
+    }
+    return 0;
+}
+
+double FeatureSpace::value(const UserProfile& profile, Feature feature) {
+    switch (feature) {
+        case FEATURE_AGE: return profile.age;
+        case FEATURE_GENDER: return WellnessBot::encodeGender(profile.gender);
+        case FEATURE_HEIGHT: return profile.height;
+        case FEATURE_WEIGHT: return profile.weight;
+        case FEATURE_BMI: return profile.bmi;
+        case FEATURE_BMR: return profile.bmr;
+        case FEATURE_DAILY_CALORIES: return profile.dailyCalories;
+        case FEATURE_ACTIVITY: return WellnessBot::encodeActivityLevel(profile.activityLevel);
+        case FEATURE_SLEEP: return profile.sleepHours;
+        case FEATURE_LIFESTYLE: return WellnessBot::encodeLifestyle(profile.lifestyle);
+        case FEATURE_DIET: return WellnessBot::encodeDietaryPref(profile.dietaryPref);
+    }
+    return 0;
+}
+
+SimilarityIndex::SimilarityIndex(const ProfileColumns& columns, NumaWorkerPool& pool, size_t lists) {
+    size_t n = columns.size();
+    if (n > numeric_limits<uint32_t>::max())
+        throw invalid_argument("Similarity index holds at most 2^32 - 1 profiles");
+    featureSpace = FeatureSpace::fit(columns, pool);
+    if (lists == 0 && n > EXACT_MAX_ROWS)
+        lists = static_cast<size_t>(sqrt(static_cast<double>(n)));
+    lists = min(lists, n);
+
+    if (lists == 0) {
+        points.resize(n);
+        pool.run([&](size_t node, unsigned index, unsigned) {
+            pair<size_t, size_t> range = pool.threadRange(node, index, n);
+            for (size_t i = range.first; i < range.second; i++)
+                points[i] = featureSpace.point(columns, i);
+        });
+        return;
+    }
+    trainCentroids(columns, pool, lists);
+    buildLists(columns, pool);
+}
+
+vector<SimilarityIndex::Neighbor> SimilarityIndex::search(const Point& query, size_t k, size_t probes) const {
+    if (centroids.empty() || probes >= centroids.size())
+        return searchExact(query, k);
+
+    // Rank the lists by centroid distance and scan the closest
+    vector<float> distances(centroids.size());
+    FeatureSpace::squaredDistances(centroids.data(), centroids.size(), query, distances.data());
+    vector<uint32_t> order(centroids.size());
+    for (uint32_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    partial_sort(order.begin(), order.begin() + probes, order.end(),
+                 [&](uint32_t a, uint32_t b) { return distances[a] < distances[b]; });
+
+    vector<Neighbor> heap;
+    heap.reserve(k + 1);
+    for (size_t p = 0; p < probes; p++) {
+        size_t list = order[p];
+        scan(listStart[list], listStart[list + 1], query, k, heap);
+    }
+    sort_heap(heap.begin(), heap.end());
+    return heap;
+}
+
+void SimilarityIndex::scan(size_t begin, size_t end, const Point& query, size_t k,
+                           vector<Neighbor>& heap) const {
+    if (k == 0)
+        return;
+    const size_t CHUNK = 256;
+    float distances[CHUNK];
+    for (size_t first = begin; first < end; first += CHUNK) {
+        size_t n = min(CHUNK, end - first);
+        FeatureSpace::squaredDistances(points.data() + first, n, query, distances);
+        for (size_t i = 0; i < n; i++) {
+            if (heap.size() == k && !(distances[i] < heap.front().distance))
+                continue;
+            Neighbor candidate = {distances[i], static_cast<uint32_t>(rows.empty() ? first + i
+                                                                                   : rows[first + i])};
+            if (heap.size() == k) {
+                if (!(candidate < heap.front()))
+                    continue;
+                pop_heap(heap.begin(), heap.end());
+                heap.pop_back();
+            }
+            heap.push_back(candidate);
+            push_heap(heap.begin(), heap.end());
+        }
+    }
+}
+
+void SimilarityIndex::trainCentroids(const ProfileColumns& columns, NumaWorkerPool& pool, size_t lists) {
+    size_t n = columns.size();
+    size_t sampleSize = min(n, lists * SAMPLE_PER_LIST);
+    vector<Point> sample(sampleSize);
+    for (size_t i = 0; i < sampleSize; i++)
+        sample[i] = featureSpace.point(columns, i * n / sampleSize);
+
+    size_t groupCount = max<size_t>(1, static_cast<size_t>(sqrt(static_cast<double>(lists))));
+    vector<Point> groups = kMeans(sample, groupCount, &pool);
+    vector<vector<Point>> members(groupCount);
+    for (const Point& p : sample)
+        members[FeatureSpace::nearest(groups.data(), groupCount, p)].push_back(p);
+
+    // Each group gets lists in proportion to its share of the sample
+    vector<size_t> firstList(groupCount + 1, 0);
+    for (size_t g = 0; g < groupCount; g++) {
+        size_t share = members[g].empty() ? 0 : max<size_t>(1, lists * members[g].size() / sampleSize);
+        firstList[g + 1] = firstList[g] + min(share, members[g].size());
+    }
+    vector<vector<Point>> groupLists(groupCount);
+    pool.run([&](size_t node, unsigned index, unsigned) {
+        for (size_t g = pool.slot(node, index); g < groupCount; g += pool.threadCount())
+            groupLists[g] = kMeans(members[g], firstList[g + 1] - firstList[g], nullptr);
+    });
+
+    // Groups left without sample points get no lists and are dropped
+    centroids.resize(firstList[groupCount]);
+    groupFirstList.assign(1, 0);
+    for (size_t g = 0; g < groupCount; g++) {
+        if (groupLists[g].empty())
+            continue;
+        copy(groupLists[g].begin(), groupLists[g].end(), centroids.begin() + firstList[g]);
+        groupCentroids.push_back(groups[g]);
+        groupFirstList.push_back(firstList[g + 1]);
+    }
+}
+
+void SimilarityIndex::buildLists(const ProfileColumns& columns, NumaWorkerPool& pool) {
+    size_t n = columns.size();
+    size_t lists = centroids.size();
+    Column<uint32_t> listOf(n);
+    vector<vector<size_t>> counts(pool.threadCount(), vector<size_t>(lists, 0));
+
+    pool.run([&](size_t node, unsigned index, unsigned) {
+        vector<size_t>& local = counts[pool.slot(node, index)];
+        pair<size_t, size_t> range = pool.threadRange(node, index, n);
+        for (size_t i = range.first; i < range.second; i++) {
+            uint32_t list = assign(featureSpace.point(columns, i));
+            listOf[i] = list;
+            local[list]++;
+        }
+    });
+
+    // Slot s writes list l from listStart[l] + counts of earlier slots
+    listStart.assign(lists + 1, 0);
+    for (size_t l = 0; l < lists; l++) {
+        size_t offset = listStart[l];
+        for (vector<size_t>& local : counts) {
+            size_t count = local[l];
+            local[l] = offset;
+            offset += count;
+        }
+        listStart[l + 1] = offset;
+    }
+
+    points.resize(n);
+    rows.resize(n);
+    pool.run([&](size_t node, unsigned index, unsigned) {
+        vector<size_t>& next = counts[pool.slot(node, index)];
+        pair<size_t, size_t> range = pool.threadRange(node, index, n);
+        for (size_t i = range.first; i < range.second; i++) {
+            size_t position = next[listOf[i]]++;
+            points[position] = featureSpace.point(columns, i);
+            rows[position] = static_cast<uint32_t>(i);
+        }
+    });
+}
+
+vector<SimilarityIndex::Point> SimilarityIndex::kMeans(const vector<Point>& data, size_t k,
+                                                       NumaWorkerPool* pool) {
+    vector<Point> centers(k);
+    for (size_t c = 0; c < k; c++)
+        centers[c] = data[c * data.size() / k];
+    vector<uint32_t> nearest(data.size());
+    for (int iteration = 0; iteration < TRAINING_ITERATIONS && k > 0; iteration++) {
+        auto assignRange = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                nearest[i] = static_cast<uint32_t>(FeatureSpace::nearest(centers.data(), k, data[i]));
+        };
+        if (pool) {
+            size_t threads = pool->threadCount();
+            pool->run([&](size_t node, unsigned index, unsigned) {
+                size_t slot = pool->slot(node, index);
+                assignRange(data.size() * slot / threads, data.size() * (slot + 1) / threads);
+            });
+        } else {
+            assignRange(0, data.size());
+        }
+
+        vector<array<double, FeatureSpace::DIMENSIONS>> sums(k, array<double, FeatureSpace::DIMENSIONS>{});
+        vector<size_t> sizes(k, 0);
+        for (size_t i = 0; i < data.size(); i++) {
+            sizes[nearest[i]]++;
+            for (int d = 0; d < FeatureSpace::DIMENSIONS; d++)
+                sums[nearest[i]][d] += data[i].f[d];
+        }
+        for (size_t c = 0; c < k; c++) {
+            if (sizes[c] == 0)
+                continue;
+            for (int d = 0; d < FeatureSpace::DIMENSIONS; d++)
+                centers[c].f[d] = static_cast<float>(sums[c][d] / sizes[c]);
+        }
+    }
+    return centers;
+}
+
+PopulationClusters::PopulationClusters(const ProfileColumns& columns, NumaWorkerPool& pool, size_t k,
+                                       const WellnessBot::WellnessConfig& cfg,
+                                       const WellnessBot::GrowthChart* chart, uint32_t seed) {
+    if (k == 0)
+        throw invalid_argument("Persona count must be at least 1");
+    if (columns.size() == 0)
+        return;
+    featureSpace = FeatureSpace::fit(columns, pool, FeatureSpace::PERSONA_FEATURES);
+    mt19937_64 rng(seed);
+    seedCenters(columns, min(k, columns.size()), rng);
+    refine(columns, pool, rng);
+    summarize(columns, pool, cfg, chart);
+}
+
+void PopulationClusters::print(ostream& out) const {
+    uint64_t total = 0;
+    for (const Persona& persona : summaries)
+        total += persona.users;
+    out << fixed;
+    for (size_t c = 0; c < summaries.size(); c++) {
+        const Persona& p = summaries[c];
+        out << "Persona " << c + 1 << ": " << p.users << " users ("
+            << setprecision(1) << percent(p.users, total) << "%)\n"
+            << "  Mean age " << p.age << ", BMI " << setprecision(2) << p.bmi << ", BMR " << p.bmr
+            << ", daily calories " << p.dailyCalories << ", sleep " << setprecision(1)
+            << p.sleepHours << " h\n";
+        out << "  BMI categories:";
+        for (int b = 0; b < WellnessBot::BMI_CATEGORY_COUNT; b++) {
+            out << (b ? ", " : " ") << WellnessBot::BMI_CATEGORY_NAMES[b] << " "
+                << percent(p.bmiCategories[b], p.users) << "%";
+        }
+        out << "\n  Mostly " << dominant(WellnessBot::GENDER_NAMES, p.genders, p.users) << ", "
+            << dominant(WellnessBot::ACTIVITY_NAMES, p.activityLevels, p.users) << ", lifestyle "
+            << dominant(WellnessBot::LIFESTYLE_NAMES, p.lifestyles, p.users) << ", diet "
+            << dominant(WellnessBot::DIET_NAMES, p.diets, p.users) << "\n";
+    }
+}
+
+void PopulationClusters::seedCenters(const ProfileColumns& columns, size_t k, mt19937_64& rng) {
+    size_t n = columns.size();
+    size_t sampleSize = min(n, SEED_SAMPLE_ROWS);
+    FeatureSpace::Points sample(sampleSize);
+    uniform_int_distribution<size_t> anyRow(0, n - 1);
+    for (size_t i = 0; i < sampleSize; i++)
+        sample[i] = featureSpace.point(columns, sampleSize == n ? i : anyRow(rng));
+
+    vector<float> nearest(sampleSize, numeric_limits<float>::infinity());
+    vector<float> distances(sampleSize);
+    uniform_int_distribution<size_t> anyPoint(0, sampleSize - 1);
+    centers.assign(1, sample[anyPoint(rng)]);
+    while (centers.size() < k) {
+        FeatureSpace::squaredDistances(sample.data(), sampleSize, centers.back(), distances.data());
+        double total = 0;
+        for (size_t i = 0; i < sampleSize; i++) {
+            nearest[i] = min(nearest[i], distances[i]);
+            total += nearest[i];
+        }
+        // Every point sits on a center: the sample has fewer distinct points than k
+        if (total == 0)
+            break;
+        double target = uniform_real_distribution<double>(0, total)(rng);
+        size_t chosen = 0;
+        for (double sum = 0; chosen + 1 < sampleSize; chosen++) {
+            sum += nearest[chosen];
+            if (sum > target)
+                break;
+        }
+        centers.push_back(sample[chosen]);
+    }
+}
+
+void PopulationClusters::refine(const ProfileColumns& columns, NumaWorkerPool& pool, mt19937_64& rng) {
+    size_t n = columns.size();
+    size_t k = centers.size();
+    vector<size_t> batch(BATCH_ROWS);
+    vector<Point> points(BATCH_ROWS);
+    vector<uint32_t> nearest(BATCH_ROWS);
+    vector<double> seen(k, 0);
+    uniform_int_distribution<size_t> anyRow(0, n - 1);
+    size_t threads = pool.threadCount();
+
+    for (int iteration = 0; iteration < ITERATIONS; iteration++) {
+        for (size_t& row : batch)
+            row = anyRow(rng);
+        pool.run([&](size_t node, unsigned index, unsigned) {
+            size_t slot = pool.slot(node, index);
+            for (size_t i = BATCH_ROWS * slot / threads; i < BATCH_ROWS * (slot + 1) / threads; i++) {
+                points[i] = featureSpace.point(columns, batch[i]);
+                nearest[i] = static_cast<uint32_t>(FeatureSpace::nearest(centers.data(), k, points[i]));
+            }
+        });
+        for (size_t i = 0; i < BATCH_ROWS; i++) {
+            Point& center = centers[nearest[i]];
+            float step = static_cast<float>(1 / ++seen[nearest[i]]);
+            for (int d = 0; d < FeatureSpace::DIMENSIONS; d++)
+                center.f[d] += step * (points[i].f[d] - center.f[d]);
+        }
+    }
+}
+
+void PopulationClusters::summarize(const ProfileColumns& columns, NumaWorkerPool& pool,
+                                   const WellnessBot::WellnessConfig& cfg,
+                                   const WellnessBot::GrowthChart* chart) {
+    size_t k = centers.size();
+    vector<vector<Persona>> partials(pool.threadCount());
+    vector<double> distances(pool.threadCount(), 0);
+    pool.run([&](size_t node, unsigned index, unsigned) {
+        size_t slot = pool.slot(node, index);
+        vector<Persona> local(k);
+        double distance = 0;
+        pair<size_t, size_t> range = pool.threadRange(node, index, columns.size());
+        for (size_t i = range.first; i < range.second; i++) {
+            Point p = featureSpace.point(columns, i);
+            size_t c = FeatureSpace::nearest(centers.data(), k, p);
+            distance += FeatureSpace::squaredDistance(p, centers[c]);
+            Persona& persona = local[c];
+            persona.users++;
+            persona.age += columns.age[i];
+            persona.bmi += columns.bmi[i];
+            persona.bmr += columns.bmr[i];
+            persona.dailyCalories += columns.dailyCalories[i];
+            persona.sleepHours += columns.sleepHours[i];
+            persona.bmiCategories[columns.bmiCategory(i, cfg, chart)]++;
+            persona.genders[columns.gender[i]]++;
+            persona.activityLevels[columns.activityLevel[i]]++;
+            persona.lifestyles[columns.lifestyle[i]]++;
+            persona.diets[columns.dietaryPref[i]]++;
+        }
+        partials[slot] = move(local);
+        distances[slot] = distance;
+    });
+
+    summaries.assign(k, Persona());
+    inertia = 0;
+    for (size_t slot = 0; slot < partials.size(); slot++) {
+        inertia += distances[slot];
+        for (size_t c = 0; c < k; c++)
+            merge(summaries[c], partials[slot][c]);
+    }
+    inertia /= static_cast<double>(columns.size());
+    for (size_t c = 0; c < k; c++) {
+        Persona& p = summaries[c];
+        p.center = centers[c];
+        double users = max<double>(1, static_cast<double>(p.users));
+        p.age /= users;
+        p.bmi /= users;
+        p.bmr /= users;
+        p.dailyCalories /= users;
+        p.sleepHours /= users;
+    }
+    stable_sort(summaries.begin(), summaries.end(),
+                [](const Persona& a, const Persona& b) { return a.users > b.users; });
+    for (size_t c = 0; c < k; c++)
+        centers[c] = summaries[c].center;
+}
+
+void PopulationClusters::merge(Persona& total, const Persona& part) {
+    total.users += part.users;
+    total.age += part.age;
+    total.bmi += part.bmi;
+    total.bmr += part.bmr;
+    total.dailyCalories += part.dailyCalories;
+    total.sleepHours += part.sleepHours;
+    for (size_t i = 0; i < total.bmiCategories.size(); i++)
+        total.bmiCategories[i] += part.bmiCategories[i];
+    for (size_t i = 0; i < total.genders.size(); i++)
+        total.genders[i] += part.genders[i];
+    for (size_t i = 0; i < total.activityLevels.size(); i++)
+        total.activityLevels[i] += part.activityLevels[i];
+    for (size_t i = 0; i < total.lifestyles.size(); i++)
+        total.lifestyles[i] += part.lifestyles[i];
+    for (size_t i = 0; i < total.diets.size(); i++)
+        total.diets[i] += part.diets[i];
+}
+
+bool ProfileCsv::parse(const string& line, uint64_t& userId, UserProfile& profile) {
+    string fields[FIELD_COUNT];
+    size_t start = 0;
+    int count = 0;
+    while (true) {
+        if (count == FIELD_COUNT)
+            return false;
+        size_t comma = line.find(',', start);
+        fields[count++] = trim(line.substr(start, comma == string::npos ? string::npos : comma - start));
+        if (comma == string::npos)
+            break;
+        start = comma + 1;
+    }
+    if (count < REQUIRED_FIELDS)
+        return false;
+
+    long age, sleep;
+    double height, weight;
+    if (!parseUnsigned(fields[0], userId) || !parseLong(fields[1], age) ||
+        !WellnessBot::parseHeight(fields[3], height) || !WellnessBot::parseWeight(fields[4], weight) ||
+        !parseLong(fields[6], sleep))
+        return false;
+    if (age < WellnessBot::MIN_AGE || age > WellnessBot::MAX_AGE ||
+        !(height >= WellnessBot::MIN_HEIGHT && height <= WellnessBot::MAX_HEIGHT) ||
+        !(weight >= WellnessBot::MIN_WEIGHT && weight <= WellnessBot::MAX_WEIGHT) ||
+        sleep < WellnessBot::MIN_SLEEP_HOURS || sleep > WellnessBot::MAX_SLEEP_HOURS)
+        return false;
+
+    profile.age = static_cast<int>(age);
+    profile.height = height;
+    profile.weight = weight;
+    profile.sleepHours = static_cast<int>(sleep);
+    profile.gender = lower(fields[2]);
+    profile.activityLevel = lower(fields[5]);
+    profile.lifestyle = lower(fields[7]);
+    profile.dietaryPref = lower(fields[8]);
+    profile.goal = count > 9 && !fields[9].empty() ? lower(fields[9])
+                                                  : WellnessBot::GOAL_NAMES[WellnessBot::GOAL_MAINTAIN];
+    if (count != 10 && count != REQUIRED_FIELDS) {
+        if (count != FIELD_COUNT || !parseCircumference(fields[10], profile.waist) ||
+            !parseCircumference(fields[11], profile.neck) ||
+            !parseCircumference(fields[12], profile.hip))
+            return false;
+    }
+    return WellnessBot::encodeGoal(profile.goal) != WellnessBot::GOAL_COUNT &&
+           WellnessBot::encodeGender(profile.gender) != WellnessBot::GENDER_COUNT &&
+           WellnessBot::encodeActivityLevel(profile.activityLevel) != WellnessBot::ACTIVITY_COUNT &&
+           WellnessBot::encodeLifestyle(profile.lifestyle) != WellnessBot::LIFESTYLE_COUNT &&
+           WellnessBot::encodeDietaryPref(profile.dietaryPref) != WellnessBot::DIET_COUNT;
+}
+
+size_t ProfileCsv::load(const string& path, ProfileColumns& columns) {
+    ifstream in(path);
+    if (!in)
+        throw runtime_error("Cannot read population: " + path);
+    size_t skipped = 0;
+    string line;
+    while (getline(in, line)) {
+        // Blank and comment lines are skipped as in the batch reader, not counted
+        if (line.empty() || line[0] == '#')
+            continue;
+        uint64_t userId;
+        UserProfile profile;
+        if (parse(line, userId, profile))
+            columns.append(profile);
+        else
+            skipped++;
+    }
+    return skipped;
+}
+
+// C ABI declared in wellness.h. Calls use only their arguments and a
+// caller-owned or constant default config, and report errors as status codes.
+struct wellness_config {
+    WellnessBot::WellnessConfig config;
+    unique_ptr<WellnessBot::GrowthChart> growthChart;  // null: adult thresholds for everyone
+};
+
+static_assert(sizeof(profile_t) == 48 && sizeof(metrics_t) == 72, "C ABI struct layout changed");
+static_assert(int(WELLNESS_GENDER_FEMALE) == int(WellnessBot::GENDER_FEMALE) &&
+                  int(WELLNESS_ACTIVITY_VERY_ACTIVE) == int(WellnessBot::ACTIVITY_VERY_ACTIVE) &&
+                  int(WELLNESS_LIFESTYLE_NONE) == int(WellnessBot::LIFESTYLE_NONE) &&
+                  int(WELLNESS_DIET_NONE) == int(WellnessBot::DIET_NONE) &&
+                  int(WELLNESS_GOAL_GAIN) == int(WellnessBot::GOAL_GAIN),
+              "C ABI codes must match the WellnessBot enums");
+static_assert(WELLNESS_MAX_RECOMMENDATIONS == WellnessBot::MAX_RECOMMENDATIONS,
+              "C ABI recommendation capacity changed");
+
+static const WellnessBot::WellnessConfig& configOrDefault(const wellness_config_t* config) {
+    return config ? config->config : WellnessBot::defaultConfig();
+}
+
+static const WellnessBot::GrowthChart* growthChartOf(const wellness_config_t* config) {
+    return config ? config->growthChart.get() : nullptr;
+}
+
+static bool validCodes(const profile_t& p) {
+    return p.gender < WellnessBot::GENDER_COUNT && p.activity_level < WellnessBot::ACTIVITY_COUNT &&
+           p.lifestyle < WellnessBot::LIFESTYLE_COUNT && p.dietary_pref < WellnessBot::DIET_COUNT &&
+           p.goal < WellnessBot::GOAL_COUNT;
+}
+
+static WellnessBot::UserProfile userProfile(const profile_t& p, const metrics_t& m) {
+    WellnessBot::UserProfile profile;
+    profile.age = p.age;
+    profile.gender = WellnessBot::GENDER_NAMES[p.gender];
+    profile.height = p.height;
+    profile.weight = p.weight;
+    profile.activityLevel = WellnessBot::ACTIVITY_NAMES[p.activity_level];
+    profile.sleepHours = p.sleep_hours;
+    profile.lifestyle = WellnessBot::LIFESTYLE_NAMES[p.lifestyle];
+    profile.dietaryPref = WellnessBot::DIET_NAMES[p.dietary_pref];
+    profile.goal = WellnessBot::GOAL_NAMES[p.goal];
+    profile.waist = p.waist;
+    profile.neck = p.neck;
+    profile.hip = p.hip;
+    profile.bmi = m.bmi;
+    profile.bmr = m.bmr;
+    profile.dailyCalories = m.daily_calories;
+    profile.bodyFatPercent = m.body_fat_percent;
+    profile.leanBodyMass = m.lean_body_mass;
+    return profile;
+}
+
+extern "C" {
+
+int wellness_abi_version(void) {
+    return WELLNESS_ABI_VERSION;
+}
+
+wellness_config_t* wellness_config_load(const char* path, char* error, size_t capacity) {
+    try {
+        if (!path)
+            throw invalid_argument("no config path");
+        return new wellness_config{ConfigFile::load(path), nullptr};
+    }
+    catch (const exception& e) {
+        if (error && capacity > 0)
+            snprintf(error, capacity, "%s", e.what());
+    }
+    catch (...) {
+        if (error && capacity > 0)
+            snprintf(error, capacity, "unknown error");
+    }
+    return nullptr;
+}
+
+int wellness_config_load_growth_chart(wellness_config_t* config, const char* path, char* error,
+                                      size_t capacity) {
+    if (!config || !path)
+        return WELLNESS_EINVAL;
+    try {
+        config->growthChart.reset(new WellnessBot::GrowthChart(GrowthChartFile::load(path)));
+        return WELLNESS_OK;
+    }
+    catch (const exception& e) {
+        if (error && capacity > 0)
+            snprintf(error, capacity, "%s", e.what());
+    }
+    catch (...) {
+        if (error && capacity > 0)
+            snprintf(error, capacity, "unknown error");
+    }
+    return WELLNESS_EINTERNAL;
+}
+
+void wellness_config_free(wellness_config_t* config) {
+    delete config;
+}
+
+int wellness_compute_batch(const profile_t* profiles, size_t count, metrics_t* metrics) {
+    return wellness_compute_batch_config(nullptr, profiles, count, metrics);
+}
+
+// Runs the columnar kernels over blocks of rows
+int wellness_compute_batch_config(const wellness_config_t* config, const profile_t* profiles,
+                                  size_t count, metrics_t* metrics) {
+    if (count > 0 && (!profiles || !metrics))
+        return WELLNESS_EINVAL;
+    try {
+        const WellnessBot::WellnessConfig& cfg = configOrDefault(config);
+        int status = WELLNESS_OK;
+        ProfileColumns columns;
+        columns.resize(min(count, ProfileColumns::BLOCK_ROWS));
+        for (size_t first = 0; first < count; first += ProfileColumns::BLOCK_ROWS) {
+            size_t n = min(count - first, ProfileColumns::BLOCK_ROWS);
+            for (size_t j = 0; j < n; j++) {
+                const profile_t& p = profiles[first + j];
+                columns.age[j] = p.age;
+                columns.sleepHours[j] = p.sleep_hours;
+                columns.gender[j] = p.gender;
+                columns.activityLevel[j] = p.activity_level;
+                columns.lifestyle[j] = p.lifestyle;
+                columns.dietaryPref[j] = p.dietary_pref;
+                columns.goal[j] = p.goal;
+                columns.height[j] = p.height;
+                columns.weight[j] = p.weight;
+                columns.waist[j] = p.waist;
+                columns.neck[j] = p.neck;
+                columns.hip[j] = p.hip;
+            }
+            columns.calculateMetrics(cfg, 0, n);
+            columns.calculateMacros(cfg, 0, n);
+
+            for (size_t j = 0; j < n; j++) {
+                metrics_t& m = metrics[first + j];
+                memset(&m, 0, sizeof(m));
+                if (!validCodes(profiles[first + j])) {
+                    double nan = numeric_limits<double>::quiet_NaN();
+                    m.bmi = m.bmr = m.daily_calories = m.body_fat_percent = m.lean_body_mass = nan;
+                    m.carbs_grams = m.protein_grams = m.fats_grams = nan;
+                    m.bmi_category = WellnessBot::BMI_CATEGORY_COUNT;
+                    status = WELLNESS_EINVAL;
+                    continue;
+                }
+                m.bmi = columns.bmi[j];
+                m.bmr = columns.bmr[j];
+                m.daily_calories = columns.dailyCalories[j];
+                m.body_fat_percent = columns.bodyFatPercent[j];
+                m.lean_body_mass = columns.leanBodyMass[j];
+                m.carbs_grams = columns.carbsGrams[j];
+                m.protein_grams = columns.proteinGrams[j];
+                m.fats_grams = columns.fatsGrams[j];
+                m.bmi_category = columns.bmiCategory(j, cfg, growthChartOf(config));
+            }
+        }
+        return status;
+    }
+    catch (...) {
+        return WELLNESS_EINTERNAL;
+    }
+}
+
+// Rows per thread below which wellness_compute_columns does not start threads
+static const size_t COLUMNS_ROWS_PER_THREAD = 65536;
+
+// Runs the metrics kernel over rows [begin, end) of caller columns, one block
+// at a time so optional columns can be filled in from local buffers
+static bool computeColumnRange(const WellnessBot::WellnessConfig& cfg, const wellness_columns_t& c,
+                               size_t begin, size_t end) {
+    const size_t BLOCK = ProfileColumns::BLOCK_ROWS;
+    vector<double> zeros(c.waist && c.neck && c.hip ? 0 : BLOCK, 0.0);
+    vector<double> fat(c.body_fat_percent ? 0 : BLOCK), lean(c.lean_body_mass ? 0 : BLOCK);
+    bool valid = true;
+    for (size_t first = begin; first < end; first += BLOCK) {
+        size_t n = min(BLOCK, end - first);
+        // Pointers shifted so the kernel's row index can stay first-based
+        auto at = [&](const double* column, const vector<double>& local) {
+            return column ? column : local.data() - first;
+        };
+        auto out = [&](double* column, vector<double>& local) {
+            return column ? column : local.data() - first;
+        };
+        ProfileColumns::MetricsView view = {
+            c.age, c.gender, c.activity_level, c.height, c.weight,
+            at(c.waist, zeros), at(c.neck, zeros), at(c.hip, zeros),
+            c.bmi, c.bmr, c.daily_calories,
+            out(c.body_fat_percent, fat), out(c.lean_body_mass, lean)};
+        ProfileColumns::calculateMetrics(cfg, view, first, first + n);
+
+        for (size_t i = first; i < first + n; i++) {
+            if (c.gender[i] >= WellnessBot::GENDER_COUNT || c.activity_level[i] >= WellnessBot::ACTIVITY_COUNT) {
+                double nan = numeric_limits<double>::quiet_NaN();
+                c.bmi[i] = c.bmr[i] = c.daily_calories[i] = nan;
+                if (c.body_fat_percent)
+                    c.body_fat_percent[i] = nan;
+                if (c.lean_body_mass)
+                    c.lean_body_mass[i] = nan;
+                valid = false;
+            }
+        }
+    }
+    return valid;
+}
+
+int wellness_compute_columns(const wellness_config_t* config, const wellness_columns_t* columns,
+                             unsigned threads) {
+    if (!columns)
+        return WELLNESS_EINVAL;
+    const wellness_columns_t& c = *columns;
+    if (c.count > 0 && (!c.age || !c.gender || !c.activity_level || !c.height || !c.weight ||
+                        !c.bmi || !c.bmr || !c.daily_calories))
+        return WELLNESS_EINVAL;
+    try {
+        const WellnessBot::WellnessConfig& cfg = configOrDefault(config);
+        if (threads == 0)
+            threads = max(1u, thread::hardware_concurrency());
+        size_t blocks = (c.count + ProfileColumns::BLOCK_ROWS - 1) / ProfileColumns::BLOCK_ROWS;
+        threads = static_cast<unsigned>(min<size_t>(
+            {threads, max<size_t>(1, c.count / COLUMNS_ROWS_PER_THREAD), max<size_t>(1, blocks)}));
+        if (threads == 1)
+            return computeColumnRange(cfg, c, 0, c.count) ? WELLNESS_OK : WELLNESS_EINVAL;
+
+        // Block-aligned ranges, one per thread; the caller's thread takes the first
+        vector<thread> workers;
+        vector<char> valid(threads, 1);
+        vector<exception_ptr> failures(threads);
+        auto range = [&](unsigned t) {
+            size_t begin = min(c.count, blocks * t / threads * ProfileColumns::BLOCK_ROWS);
+            size_t end = min(c.count, blocks * (t + 1) / threads * ProfileColumns::BLOCK_ROWS);
+            try {
+                valid[t] = computeColumnRange(cfg, c, begin, end);
+            }
+            catch (...) {
+                failures[t] = current_exception();
+            }
+        };
+        for (unsigned t = 1; t < threads; t++)
+            workers.emplace_back(range, t);
+        range(0);
+        for (auto& worker : workers)
+            worker.join();
+        for (const auto& failure : failures) {
+            if (failure)
+                return WELLNESS_EINTERNAL;
+        }
+        return count(valid.begin(), valid.end(), 0) == 0 ? WELLNESS_OK : WELLNESS_EINVAL;
+    }
+    catch (...) {
+        return WELLNESS_EINTERNAL;
+    }
+}
+
+int wellness_render(const wellness_config_t* config, const profile_t* profile, const metrics_t* metrics,
+                    char* buffer, size_t capacity, size_t* length) {
+    if (!profile || !metrics || !length || (capacity > 0 && !buffer) || !validCodes(*profile))
+        return WELLNESS_EINVAL;
+    try {
+        const WellnessBot::WellnessConfig& cfg = configOrDefault(config);
+        WellnessBot bot;
+        bot.publishGrowthChart(growthChartOf(config));
+        ostringstream text;
+        WellnessBot::MacroGrams grams = {metrics->carbs_grams, metrics->protein_grams, metrics->fats_grams};
+        bot.displayResults(userProfile(*profile, *metrics), text, cfg, grams);
+        string report = text.str();
+        *length = report.size();
+        if (capacity <= report.size())
+            return WELLNESS_ENOSPC;
+        memcpy(buffer, report.data(), report.size());
+        buffer[report.size()] = '\0';
+        return WELLNESS_OK;
+    }
+    catch (...) {
+        return WELLNESS_EINTERNAL;
+    }
+}
+
+int wellness_recommendations(const wellness_config_t* config, const profile_t* profile,
+                             const metrics_t* metrics, uint16_t* ids, size_t capacity, size_t* count) {
+    if (!profile || !metrics || !count || (capacity > 0 && !ids) || !validCodes(*profile))
+        return WELLNESS_EINVAL;
+    WellnessBot::BMICategory category = WellnessBot::bmiCategory(
+        metrics->bmi, profile->age, profile->gender, configOrDefault(config), growthChartOf(config));
+    WellnessBot::Recommendations recs = WellnessBot::recommendations(
+        category, profile->sleep_hours, profile->dietary_pref, profile->lifestyle);
+    *count = recs.count;
+    if (capacity < recs.count)
+        return WELLNESS_ENOSPC;
+    copy(recs.ids.begin(), recs.ids.begin() + recs.count, ids);
+    return WELLNESS_OK;
+}
+
+const char* wellness_recommendation_text(uint16_t id) {
+    return id < WellnessBot::RECOMMENDATION_COUNT ? WellnessBot::ENGLISH_CATALOG.text(id) : nullptr;
+}
+
+}  // extern "C"
@@ -0,0 +1,145 @@
+/*
+	libwellness: C ABI over the Wellness Bot calculations
+
+	Build with make: "make libwellness.so" for the shared library and
+	"make libwellness.a" for the static one, both from wellness.cpp. Link
+	the static library with -pthread and the C++ runtime (g++ or -lstdc++).
+
+	All buffers are owned by the caller. No call throws or keeps state between
+	calls, so every function may be called concurrently from any thread.
+	Functions return WELLNESS_OK or a negative WELLNESS_E* status.
+*/
+
+#ifndef WELLNESS_H
+#define WELLNESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define WELLNESS_API __attribute__((visibility("default")))
+#else
+#define WELLNESS_API
+#endif
+
+/* Bumped whenever a struct layout or function signature changes */
+#define WELLNESS_ABI_VERSION 1
+
+#define WELLNESS_OK 0
+#define WELLNESS_EINVAL (-1)     /* null pointer, or a code out of range */
+#define WELLNESS_ENOSPC (-2)     /* output buffer too small */
+#define WELLNESS_EINTERNAL (-3)  /* allocation failure or internal error */
+
+/* Codes, in the same order as the bot's name tables */
+enum { WELLNESS_GENDER_MALE, WELLNESS_GENDER_FEMALE };
+enum {
+    WELLNESS_ACTIVITY_SEDENTARY, WELLNESS_ACTIVITY_LIGHTLY_ACTIVE,
+    WELLNESS_ACTIVITY_MODERATELY_ACTIVE, WELLNESS_ACTIVITY_VERY_ACTIVE
+};
+enum { WELLNESS_LIFESTYLE_SMOKING, WELLNESS_LIFESTYLE_ALCOHOL, WELLNESS_LIFESTYLE_NONE };
+enum { WELLNESS_DIET_VEGETARIAN, WELLNESS_DIET_VEGAN, WELLNESS_DIET_NONE };
+enum { WELLNESS_GOAL_MAINTAIN, WELLNESS_GOAL_LOSE, WELLNESS_GOAL_GAIN };
+
+typedef struct wellness_profile {
+    double height;          /* meters */
+    double weight;          /* kg */
+    double waist;           /* circumferences in cm, 0 if not measured */
+    double neck;
+    double hip;
+    uint8_t age;
+    uint8_t sleep_hours;
+    uint8_t gender;
+    uint8_t activity_level;
+    uint8_t lifestyle;
+    uint8_t dietary_pref;
+    uint8_t goal;
+    uint8_t reserved;       /* set to 0 */
+} profile_t;
+
+typedef struct wellness_metrics {
+    double bmi;
+    double bmr;             /* calories/day */
+    double daily_calories;
+    double body_fat_percent;
+    double lean_body_mass;  /* kg */
+    double carbs_grams;
+    double protein_grams;
+    double fats_grams;
+    uint8_t bmi_category;   /* underweight, normal, overweight, obese */
+    uint8_t reserved[7];
+} metrics_t;
+
+/* Thresholds and ratios loaded from a config file; NULL means the defaults */
+typedef struct wellness_config wellness_config_t;
+
+WELLNESS_API int wellness_abi_version(void);
+
+/* Loads a "key = value" config file. On failure returns NULL and, if error
+   is not NULL, writes a NUL-terminated message of at most capacity bytes. */
+WELLNESS_API wellness_config_t* wellness_config_load(const char* path, char* error, size_t capacity);
+WELLNESS_API void wellness_config_free(wellness_config_t* config);
+
+/* Rates children's BMI category by BMI-for-age percentile from a CDC growth
+   chart CSV (bmiagerev.csv layout) in every call that takes config, instead
+   of the adult thresholds. Errors are reported as for wellness_config_load. */
+WELLNESS_API int wellness_config_load_growth_chart(wellness_config_t* config, const char* path,
+                                                   char* error, size_t capacity);
+
+/* Metrics for count profiles. Rows with an out-of-range code get NaN
+   metrics and the call returns WELLNESS_EINVAL after filling the rest. */
+WELLNESS_API int wellness_compute_batch(const profile_t* profiles, size_t count, metrics_t* metrics);
+WELLNESS_API int wellness_compute_batch_config(const wellness_config_t* config, const profile_t* profiles,
+                                               size_t count, metrics_t* metrics);
+
+/* Column arrays for wellness_compute_columns, each with count elements and
+   owned by the caller. Optional arrays may be NULL: missing circumferences
+   mean not measured, and body composition outputs are then not written. */
+typedef struct wellness_columns {
+    size_t count;
+    const uint8_t* age;
+    const uint8_t* gender;
+    const uint8_t* activity_level;
+    const double* height;
+    const double* weight;
+    const double* waist;              /* optional */
+    const double* neck;               /* optional */
+    const double* hip;                /* optional */
+    double* bmi;
+    double* bmr;
+    double* daily_calories;
+    double* body_fat_percent;         /* optional */
+    double* lean_body_mass;           /* optional */
+} wellness_columns_t;
+
+/* Computes metrics in place over column arrays, on up to threads threads
+   (0: one per CPU); small inputs stay on the calling thread. Rows with an
+   out-of-range code get NaN outputs and the call returns WELLNESS_EINVAL. */
+WELLNESS_API int wellness_compute_columns(const wellness_config_t* config,
+                                          const wellness_columns_t* columns, unsigned threads);
+
+/* Renders the assessment report for one profile as the bot prints it.
+   *length receives the report size excluding the terminating NUL; the call
+   returns WELLNESS_ENOSPC if capacity is not larger than that. */
+WELLNESS_API int wellness_render(const wellness_config_t* config, const profile_t* profile,
+                                 const metrics_t* metrics, char* buffer, size_t capacity,
+                                 size_t* length);
+
+/* Recommendation IDs for one profile, in report order. At most
+   WELLNESS_MAX_RECOMMENDATIONS are returned. */
+#define WELLNESS_MAX_RECOMMENDATIONS 12
+WELLNESS_API int wellness_recommendations(const wellness_config_t* config, const profile_t* profile,
+                                          const metrics_t* metrics, uint16_t* ids, size_t capacity,
+                                          size_t* count);
+
+/* Text of a recommendation ID, or NULL if the ID is unknown; the string is static */
+WELLNESS_API const char* wellness_recommendation_text(uint16_t id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
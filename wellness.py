@@ -0,0 +1,161 @@
+"""
+Python bindings for libwellness (see wellness.h)
+
+Build the shared library next to this file with "make libwellness.so", or
+point WELLNESS_LIBRARY at a copy built elsewhere.
+
+compute_metrics works on NumPy arrays in place: inputs are read and outputs
+written through their buffers, never copied. ctypes releases the GIL for the
+duration of each call, so other Python threads keep running while it computes.
+"""
+
+import ctypes
+import os
+
+import numpy as np
+
+ABI_VERSION = 1
+
+OK = 0
+EINVAL = -1
+ENOSPC = -2
+EINTERNAL = -3
+
+GENDER_MALE, GENDER_FEMALE = 0, 1
+(ACTIVITY_SEDENTARY, ACTIVITY_LIGHTLY_ACTIVE,
+ ACTIVITY_MODERATELY_ACTIVE, ACTIVITY_VERY_ACTIVE) = range(4)
+
+
+class WellnessError(Exception):
+    def __init__(self, status, message):
+        super().__init__(message)
+        self.status = status
+
+
+class _Columns(ctypes.Structure):
+    _fields_ = [
+        ("count", ctypes.c_size_t),
+        ("age", ctypes.c_void_p),
+        ("gender", ctypes.c_void_p),
+        ("activity_level", ctypes.c_void_p),
+        ("height", ctypes.c_void_p),
+        ("weight", ctypes.c_void_p),
+        ("waist", ctypes.c_void_p),
+        ("neck", ctypes.c_void_p),
+        ("hip", ctypes.c_void_p),
+        ("bmi", ctypes.c_void_p),
+        ("bmr", ctypes.c_void_p),
+        ("daily_calories", ctypes.c_void_p),
+        ("body_fat_percent", ctypes.c_void_p),
+        ("lean_body_mass", ctypes.c_void_p),
+    ]
+
+
+def _load():
+    path = os.environ.get("WELLNESS_LIBRARY")
+    if not path:
+        path = os.path.join(os.path.dirname(os.path.abspath(__file__)), "libwellness.so")
+    lib = ctypes.CDLL(path)
+
+    lib.wellness_abi_version.restype = ctypes.c_int
+    lib.wellness_abi_version.argtypes = []
+    if lib.wellness_abi_version() != ABI_VERSION:
+        raise ImportError("%s has ABI version %d, expected %d"
+                          % (path, lib.wellness_abi_version(), ABI_VERSION))
+
+    lib.wellness_config_load.restype = ctypes.c_void_p
+    lib.wellness_config_load.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.c_size_t]
+    lib.wellness_config_free.restype = None
+    lib.wellness_config_free.argtypes = [ctypes.c_void_p]
+    lib.wellness_compute_columns.restype = ctypes.c_int
+    lib.wellness_compute_columns.argtypes = [ctypes.c_void_p, ctypes.POINTER(_Columns), ctypes.c_uint]
+    return lib
+
+
+_lib = _load()
+
+
+class Config:
+    """Thresholds and ratios from a "key = value" config file"""
+
+    def __init__(self, path):
+        error = ctypes.create_string_buffer(256)
+        self._handle = _lib.wellness_config_load(os.fsencode(path), error, len(error))
+        if not self._handle:
+            raise WellnessError(EINVAL, error.value.decode())
+
+    def close(self):
+        if self._handle:
+            _lib.wellness_config_free(self._handle)
+            self._handle = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+
+def _column(name, array, dtype, count, writable=False):
+    # Wrong dtypes and strided views are rejected rather than silently copied,
+    # since a copy would hide that outputs never reach the caller's array
+    if not isinstance(array, np.ndarray):
+        raise TypeError("%s must be a numpy array" % name)
+    if array.dtype != dtype:
+        raise TypeError("%s must have dtype %s, not %s" % (name, np.dtype(dtype), array.dtype))
+    if array.ndim != 1 or array.shape[0] != count:
+        raise ValueError("%s must be one-dimensional with %d elements" % (name, count))
+    if not array.flags.c_contiguous:
+        raise ValueError("%s must be contiguous" % name)
+    if writable and not array.flags.writeable:
+        raise ValueError("%s must be writeable" % name)
+    return array.ctypes.data
+
+
+def compute_metrics(age, gender, activity_level, height, weight, *,
+                    waist=None, neck=None, hip=None,
+                    bmi=None, bmr=None, daily_calories=None,
+                    body_fat_percent=None, lean_body_mass=None,
+                    config=None, threads=0):
+    """
+    Computes BMI, BMR, daily calories and body composition for every row.
+
+    age, gender and activity_level are uint8 arrays of codes; height (m),
+    weight (kg) and the optional waist, neck and hip circumferences (cm, 0 if
+    not measured) are float64. Output arrays are allocated when not given.
+    threads=0 uses one thread per CPU for large arrays.
+
+    Returns a dict of the output arrays. Rows with an out-of-range code get
+    NaN outputs and raise WellnessError after the rest are filled.
+    """
+    count = len(height)
+    columns = _Columns()
+    columns.count = count
+    columns.age = _column("age", age, np.uint8, count)
+    columns.gender = _column("gender", gender, np.uint8, count)
+    columns.activity_level = _column("activity_level", activity_level, np.uint8, count)
+    columns.height = _column("height", height, np.float64, count)
+    columns.weight = _column("weight", weight, np.float64, count)
+    for name, array in (("waist", waist), ("neck", neck), ("hip", hip)):
+        if array is not None:
+            setattr(columns, name, _column(name, array, np.float64, count))
+
+    outputs = {
+        "bmi": bmi, "bmr": bmr, "daily_calories": daily_calories,
+        "body_fat_percent": body_fat_percent, "lean_body_mass": lean_body_mass,
+    }
+    for name, array in outputs.items():
+        if array is None:
+            array = outputs[name] = np.empty(count, dtype=np.float64)
+        setattr(columns, name, _column(name, array, np.float64, count, writable=True))
+
+    handle = config._handle if config is not None else None
+    status = _lib.wellness_compute_columns(handle, ctypes.byref(columns), threads)
+    if status == EINVAL:
+        raise WellnessError(status, "gender or activity_level code out of range")
+    if status != OK:
+        raise WellnessError(status, "wellness_compute_columns failed with status %d" % status)
+    return outputs
@@ -0,0 +1,2558 @@
+/*
+	Wellness Bot calculations shared by the command-line program and
+	libwellness: profiles and their metrics, configs, message catalogs,
+	growth charts, and the columnar batch, sketch, index and clustering
+	code. Member functions of more than a few lines are defined in
+	wellness.cpp, which is built into libwellness (see the Makefile).
+*/
+
+#ifndef WELLNESS_CORE_H
+#define WELLNESS_CORE_H
+
+#include <iostream>
+#include <string>
+#include <iomanip>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <memory>
+#include <thread>
+#include <cstring>
+#include <random>
+#include <fstream>
+#include <sstream>
+#include <functional>
+#include <unordered_map>
+#include <charconv>
+#include <string_view>
+#include <initializer_list>
+#include <numeric>
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <condition_variable>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Number of strings in a blob of NUL-terminated strings
+constexpr size_t internedCount(const char* strings, size_t size) {
+    size_t count = 0;
+    for (size_t i = 0; i < size; i++)
+        count += strings[i] == '\0';
+    return count;
+}
+
+// Offsets of the first N strings in a blob of NUL-terminated strings
+template <size_t N>
+constexpr array<uint16_t, N> internedOffsets(const char* strings, size_t size) {
+    array<uint16_t, N> offsets{};
+    size_t next = 0, start = 0;
+    for (size_t i = 0; i < size && next < N; i++) {
+        if (strings[i] == '\0') {
+            offsets[next++] = static_cast<uint16_t>(start);
+            start = i + 1;
+        }
+    }
+    return offsets;
+}
+
+// Whether no element is smaller than the one before it
+template <typename T, size_t N>
+constexpr bool nonDecreasing(const T (&values)[N]) {
+    for (size_t i = 1; i < N; i++) {
+        if (values[i] < values[i - 1])
+            return false;
+    }
+    return true;
+}
+
+class WellnessBot {
+private:
+    // Constants for calculations
+    static constexpr double CALORIES_PER_GRAM_PROTEIN = 4.0;
+    static constexpr double CALORIES_PER_GRAM_CARBS = 4.0;
+    static constexpr double CALORIES_PER_GRAM_FAT = 9.0;
+
+    // Input validation functions
+    static bool isValidGender(const string& gender) {
+        string lower = gender;
+        transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        return (lower == "male" || lower == "female");
+    }
+
+    static bool isValidActivityLevel(const string& level) {
+        string lower = level;
+        transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        return (lower == "sedentary" || lower == "lightly active" || 
+                lower == "moderately active" || lower == "very active");
+    }
+
+    static bool isValidLifestyle(const string& lifestyle) {
+        string lower = lifestyle;
+        transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        return (lower == "smoking" || lower == "alcohol" || lower == "none");
+    }
+
+    static bool isValidDietaryPref(const string& pref) {
+        string lower = pref;
+        transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        return (lower == "vegetarian" || lower == "vegan" || lower == "none");
+    }
+
+public:
+    // Encoded categorical fields, in the same order as the name tables below
+    enum Gender : uint8_t { GENDER_MALE, GENDER_FEMALE, GENDER_COUNT };
+    enum ActivityLevel : uint8_t {
+        ACTIVITY_SEDENTARY, ACTIVITY_LIGHTLY_ACTIVE,
+        ACTIVITY_MODERATELY_ACTIVE, ACTIVITY_VERY_ACTIVE, ACTIVITY_COUNT
+    };
+    enum Lifestyle : uint8_t { LIFESTYLE_SMOKING, LIFESTYLE_ALCOHOL, LIFESTYLE_NONE, LIFESTYLE_COUNT };
+    enum DietaryPref : uint8_t { DIET_VEGETARIAN, DIET_VEGAN, DIET_NONE, DIET_COUNT };
+    enum Goal : uint8_t { GOAL_MAINTAIN, GOAL_LOSE, GOAL_GAIN, GOAL_COUNT };
+    enum BmrFormula : uint8_t { BMR_STANDARD, BMR_KATCH_MCARDLE, BMR_FORMULA_COUNT };
+    enum BMICategory : uint8_t {
+        BMI_UNDERWEIGHT, BMI_NORMAL, BMI_OVERWEIGHT, BMI_OBESE, BMI_CATEGORY_COUNT
+    };
+
+    static constexpr const char* GENDER_NAMES[GENDER_COUNT] = {"male", "female"};
+    static constexpr const char* ACTIVITY_NAMES[ACTIVITY_COUNT] = {
+        "sedentary", "lightly active", "moderately active", "very active"
+    };
+    static constexpr const char* LIFESTYLE_NAMES[LIFESTYLE_COUNT] = {"smoking", "alcohol", "none"};
+    static constexpr const char* DIET_NAMES[DIET_COUNT] = {"vegetarian", "vegan", "none"};
+    static constexpr const char* GOAL_NAMES[GOAL_COUNT] = {"maintain", "lose", "gain"};
+    static constexpr const char* BMR_FORMULA_NAMES[BMR_FORMULA_COUNT] = {"standard", "katch-mcardle"};
+    struct MacroRatio {
+        double carbs = 0.5;    // 50% of calories from carbs
+        double protein = 0.2;  // 20% of calories from protein
+        double fats = 0.3;     // 30% of calories from fats
+    };
+
+    // BMI category thresholds
+    struct BMIThresholds {
+        double underweight = 18.5;
+        double normal = 24.9;
+        double overweight = 29.9;
+    };
+
+    // Macronutrient split for one (diet, activity level, goal) combination
+    struct MacroProfile {
+        double carbs;
+        double protein;
+        double fats;
+        double proteinFloor;  // minimum protein in g per kg of bodyweight
+        double carbsShare;    // carbs / (carbs + fats), used when the floor applies
+    };
+
+    struct MacroGrams {
+        double carbs;
+        double protein;
+        double fats;
+    };
+
+    // Clinical thresholds and ratios. A published config is never modified;
+    // changes are made by publishing a new one (see ConfigRcu).
+    struct WellnessConfig {
+        BMIThresholds bmiThresholds;
+        MacroRatio macros;  // baseline split (no dietary preference, maintain weight)
+        // Indexed by ActivityLevel
+        array<double, ACTIVITY_COUNT> activityMultipliers = {{1.2, 1.375, 1.55, 1.725}};
+        // Indexed by macroProfileIndex(); derived from macros
+        array<MacroProfile, DIET_COUNT * ACTIVITY_COUNT * GOAL_COUNT> macroProfiles{};
+        // Katch-McArdle uses lean body mass from the body composition estimate
+        BmrFormula bmrFormula = BMR_STANDARD;
+
+        // constexpr so the default config is built at compile time
+        constexpr WellnessConfig() {
+            rebuildMacroProfiles();
+        }
+
+        const MacroProfile& macroProfile(uint8_t diet, uint8_t activity, uint8_t goal) const {
+            return macroProfiles[macroProfileIndex(diet, activity, goal)];
+        }
+
+        // Shifts the baseline split per goal, and sets protein floors per
+        // activity level, goal and diet. Diet only raises the floor: plant
+        // protein is less digestible, so vegans get a slightly higher one.
+        constexpr void rebuildMacroProfiles() {
+            const double DIET_FLOOR[DIET_COUNT] = {0.0, 0.1, 0.0};
+            const double ACTIVITY_FLOOR[ACTIVITY_COUNT] = {0.8, 1.0, 1.2, 1.4};
+            const double GOAL_FLOOR[GOAL_COUNT] = {0.0, 0.4, 0.2};
+            for (uint8_t d = 0; d < DIET_COUNT; d++) {
+                for (uint8_t a = 0; a < ACTIVITY_COUNT; a++) {
+                    for (uint8_t g = 0; g < GOAL_COUNT; g++) {
+                        double carbs = macros.carbs;
+                        double protein = macros.protein;
+                        double fats = macros.fats;
+                        if (g == GOAL_LOSE) {
+                            carbs -= 0.10;
+                            protein += 0.10;
+                        } else if (g == GOAL_GAIN) {
+                            carbs += 0.05;
+                            fats -= 0.05;
+                        }
+                        carbs = max(0.0, carbs);
+                        protein = max(0.0, protein);
+                        fats = max(0.0, fats);
+                        double total = carbs + protein + fats;
+
+                        MacroProfile& m = macroProfiles[macroProfileIndex(d, a, g)];
+                        m.carbs = carbs / total;
+                        m.protein = protein / total;
+                        m.fats = fats / total;
+                        if (g == GOAL_MAINTAIN) {
+                            m.carbs = macros.carbs;
+                            m.protein = macros.protein;
+                            m.fats = macros.fats;
+                        }
+                        m.proteinFloor = ACTIVITY_FLOOR[a] + GOAL_FLOOR[g] + DIET_FLOOR[d];
+                        m.carbsShare = m.carbs + m.fats > 0 ? m.carbs / (m.carbs + m.fats) : 0.0;
+                    }
+                }
+            }
+        }
+    };
+
+    static constexpr size_t macroProfileIndex(uint8_t diet, uint8_t activity, uint8_t goal) {
+        return (static_cast<size_t>(diet) * ACTIVITY_COUNT + activity) * GOAL_COUNT + goal;
+    }
+
+    // Grams of each macronutrient for a day's calories. When the protein
+    // floor is above the ratio's share, the extra protein calories are taken
+    // from carbs and fats in proportion. Shared by the scalar and batch paths.
+    static MacroGrams macroGrams(const MacroProfile& m, double dailyCalories, double weight) {
+        double extra = max(0.0, min(m.proteinFloor * weight * CALORIES_PER_GRAM_PROTEIN -
+                                        dailyCalories * m.protein,
+                                    dailyCalories * (m.carbs + m.fats)));
+        MacroGrams grams;
+        grams.carbs = (dailyCalories * m.carbs - extra * m.carbsShare) / CALORIES_PER_GRAM_CARBS;
+        grams.protein = (dailyCalories * m.protein + extra) / CALORIES_PER_GRAM_PROTEIN;
+        grams.fats = (dailyCalories * m.fats - extra * (1.0 - m.carbsShare)) / CALORIES_PER_GRAM_FAT;
+        return grams;
+    }
+
+    // Constant-initialized: no construction or guard check at startup
+    static const WellnessConfig& defaultConfig() {
+        static constexpr WellnessConfig config{};
+        return config;
+    }
+
+    // The config new requests should use. A request reads it once and keeps
+    // using that snapshot, so it finishes on the config it started with.
+    const WellnessConfig& config() const {
+        return *activeConfig.load(memory_order_acquire);
+    }
+
+    // The caller keeps config alive until no request can still be using it
+    void publishConfig(const WellnessConfig* config) {
+        activeConfig.store(config, memory_order_release);
+    }
+
+    // Input bounds enforced by collectUserData and the batch readers
+    static constexpr double MIN_CIRCUMFERENCE = 20.0, MAX_CIRCUMFERENCE = 250.0;  // cm, when measured
+    static constexpr int MIN_AGE = 1, MAX_AGE = 120;
+    static constexpr int ADULT_AGE = 18;  // adult-only formulas and guidance start here
+    static constexpr double MIN_HEIGHT = 0.5, MAX_HEIGHT = 2.5;
+    static constexpr double MIN_WEIGHT = 20.0, MAX_WEIGHT = 300.0;
+    static constexpr int MIN_SLEEP_HOURS = 0, MAX_SLEEP_HOURS = 24;
+
+    // Measurements with an optional unit, converted once when parsed. A bare
+    // number is in the field's base unit (meters, kg, cm). Lengths also take
+    // m, cm, in ("), ft (') and feet plus inches ("5'11\"", "5 ft 11 in");
+    // weights take kg and lb. Bounds are checked by the caller afterwards.
+    static bool parseHeight(const string& text, double& meters) {
+        return parseLength(text, MICROMETERS_PER_METER, meters);
+    }
+
+    static bool parseCircumference(const string& text, double& cm) {
+        return parseLength(text, MICROMETERS_PER_CM, cm);
+    }
+
+    static bool parseWeight(const string& text, double& kg);
+
+    static constexpr const char* BMI_CATEGORY_NAMES[BMI_CATEGORY_COUNT] = {
+        "Underweight", "Normal weight", "Overweight", "Obese"
+    };
+
+    // Recommendation lines, numbered in report order section by section, since
+    // recommendations() lists a mask's set bits lowest first. A new line goes
+    // at the end of its section, renumbering the IDs after it, so C callers
+    // should not store IDs across versions.
+    enum RecommendationSection : uint8_t {
+        SECTION_EXERCISE, SECTION_SLEEP, SECTION_NUTRITION, SECTION_LIFESTYLE, SECTION_COUNT
+    };
+    enum RecommendationId : uint16_t {
+        REC_LOW_IMPACT_ACTIVITY, REC_150_MINUTES_ACTIVITY, REC_STRENGTH_TRAINING,
+        REC_BALANCED_EXERCISE, REC_MIX_CARDIO_STRENGTH, REC_FLEXIBILITY,
+        REC_INCREASE_SLEEP, REC_SLEEP_SCHEDULE, REC_BEDTIME_ROUTINE,
+        REC_MAINTAIN_SLEEP, REC_SLEEP_QUALITY,
+        REC_COMPLETE_PROTEIN, REC_B12_IRON, REC_B12_SUPPLEMENT, REC_COMBINE_PROTEIN,
+        REC_IRON_CALCIUM_VITAMIN_D, REC_LEAN_PROTEIN, REC_VEGETABLES, REC_LIMIT_PROCESSED,
+        REC_CESSATION_PROGRAMS, REC_CESSATION_AIDS, REC_LIMIT_ALCOHOL, REC_ALCOHOL_FREE_DAYS,
+        REC_STAY_HYDRATED,
+        RECOMMENDATION_COUNT
+    };
+
+    // Every user-facing message. Recommendation IDs come first, then the
+    // section titles and BMI category names; "{}" marks an argument.
+    enum MessageId : uint16_t {
+        MESSAGE_SECTION_TITLE = RECOMMENDATION_COUNT,
+        MESSAGE_BMI_CATEGORY = MESSAGE_SECTION_TITLE + SECTION_COUNT,
+        MSG_WELCOME = MESSAGE_BMI_CATEGORY + BMI_CATEGORY_COUNT, MSG_THANK_YOU,
+        MSG_PROMPT_AGE, MSG_PROMPT_GENDER, MSG_PROMPT_HEIGHT, MSG_PROMPT_WEIGHT,
+        MSG_PROMPT_ACTIVITY, MSG_PROMPT_SLEEP, MSG_PROMPT_LIFESTYLE, MSG_PROMPT_DIET,
+        MSG_PROMPT_WAIST, MSG_PROMPT_NECK, MSG_PROMPT_HIP,
+        MSG_INVALID_RANGE, MSG_INVALID_CHOICE,
+        MSG_RESULTS_TITLE, MSG_BMI, MSG_BMR, MSG_DAILY_CALORIES, MSG_BODY_FAT,
+        MSG_METHOD_NAVY, MSG_METHOD_BMI, MSG_LEAN_BODY_MASS,
+        MSG_MACROS_TITLE, MSG_CARBS, MSG_PROTEIN, MSG_FATS,
+        MSG_RECOMMENDATIONS_TITLE, MSG_USER_ID, MSG_BMI_FOR_AGE,
+        MSG_SIMILAR_TITLE, MSG_SIMILAR_USERS, MSG_SIMILAR_BMI, MSG_SIMILAR_CALORIES, MSG_SIMILAR_GOALS,
+        MSG_PLAN_TITLE, MSG_PLAN_TARGET, MSG_PLAN_UNREACHABLE, MSG_PLAN_WEEKS, MSG_PLAN_WEEK,
+        MESSAGE_COUNT
+    };
+
+    // Interned message catalog for one locale: all strings packed into one
+    // NUL-separated blob and found through a table of 16-bit offsets
+    struct MessageCatalog {
+        const char* locale;
+        const char* strings;
+        const uint16_t* offsets;  // MESSAGE_COUNT entries
+        char decimalSeparator;
+        char groupSeparator;      // '\0' for no digit grouping
+
+        const char* text(uint16_t id) const { return strings + offsets[id]; }
+        const char* sectionTitle(int section) const { return text(MESSAGE_SECTION_TITLE + section); }
+
+        // Writes a message, replacing each "{}" with the next argument
+        void write(ostream& out, uint16_t id, initializer_list<string_view> args = {}) const;
+    };
+    static constexpr char ENGLISH_MESSAGES[] =
+        "Start with low-impact activities like walking or swimming\0"
+        "Aim for 150 minutes of moderate activity per week\0"
+        "Include strength training 2-3 times per week\0"
+        "Maintain a balanced exercise routine\0"
+        "Mix cardio with strength training\0"
+        "Consider adding flexibility exercises\0"
+        "Aim to increase sleep to 7-8 hours per night\0"
+        "Establish a regular sleep schedule\0"
+        "Create a relaxing bedtime routine\0"
+        "Maintain your good sleep habits\0"
+        "Consider sleep quality improvements\0"
+        "Focus on complete protein sources (eggs, dairy, legumes)\0"
+        "Monitor B12 and iron intake\0"
+        "Ensure adequate B12 supplementation\0"
+        "Combine protein sources for complete amino acids\0"
+        "Monitor iron, calcium, and vitamin D intake\0"
+        "Choose lean protein sources\0"
+        "Include a variety of colorful vegetables\0"
+        "Limit processed foods\0"
+        "Consider smoking cessation programs\0"
+        "Consult healthcare provider about cessation aids\0"
+        "Limit alcohol consumption\0"
+        "Consider alcohol-free days\0"
+        "Stay hydrated\0"
+        "Exercise Recommendations\0"
+        "Sleep Recommendations\0"
+        "Nutritional Recommendations\0"
+        "Lifestyle Recommendations\0"
+        "Underweight\0"
+        "Normal weight\0"
+        "Overweight\0"
+        "Obese\0"
+        "Welcome to the Wellness Bot!\0"
+        "Thank you for using Wellness Bot! Stay healthy!\0"
+        "Enter your age:\0"
+        "Enter your gender (male/female):\0"
+        "Enter your height (in meters):\0"
+        "Enter your weight (in kg):\0"
+        "Enter your activity level (sedentary, lightly active, moderately active, very active):\0"
+        "Enter your hours of sleep per night:\0"
+        "Enter your lifestyle habits (smoking, alcohol, none):\0"
+        "Enter your dietary preferences (vegetarian, vegan, none):\0"
+        "Enter your waist circumference (in cm), or press Enter to skip:\0"
+        "Enter your neck circumference (in cm), or press Enter to skip:\0"
+        "Enter your hip circumference (in cm), or press Enter to skip:\0"
+        "Invalid input. Please enter a value between {} and {}\0"
+        "Invalid input. Please try again.\0"
+        "=== Wellness Assessment Results ===\0"
+        "BMI: {} - Category: {}\0"
+        "BMR: {} calories/day\0"
+        "Daily Caloric Needs: {} calories\0"
+        "Body Fat: {}% ({})\0"
+        "US Navy method\0"
+        "estimated from BMI\0"
+        "Lean Body Mass: {} kg\0"
+        "Recommended Macronutrient Distribution:\0"
+        "Carbohydrates: {} grams\0"
+        "Protein: {} grams\0"
+        "Fats: {} grams\0"
+        "=== Personalized Recommendations ===\0"
+        "User ID: {}\0"
+        "BMI-for-age percentile: {} (z-score {})\0"
+        "=== Users Like You ===\0"
+        "Among the {} users most like you (of {}):\0"
+        "Average BMI: {} ({}% at a normal weight)\0"
+        "Average daily caloric needs: {} calories\0"
+        "Goals: {}% maintain, {}% lose weight, {}% gain weight\0"
+        "=== Goal Plan ===\0"
+        "Target BMI: {} ({} kg)\0"
+        "This target cannot be reached within safe calorie bounds.\0"
+        "Weeks to target: {}\0"
+        "Week {}: {} kg, eat {} of {} calories/day";
+    static_assert(internedCount(ENGLISH_MESSAGES, sizeof(ENGLISH_MESSAGES)) == MESSAGE_COUNT,
+                  "ENGLISH_MESSAGES must hold one string per message ID");
+    static constexpr array<uint16_t, MESSAGE_COUNT> ENGLISH_OFFSETS =
+        internedOffsets<MESSAGE_COUNT>(ENGLISH_MESSAGES, sizeof(ENGLISH_MESSAGES));
+    static constexpr MessageCatalog ENGLISH_CATALOG = {"en", ENGLISH_MESSAGES, ENGLISH_OFFSETS.data(),
+                                                       '.', '\0'};
+
+    // The catalog new requests render with; switching locale is one pointer store
+    const MessageCatalog& catalog() const {
+        return *activeCatalog.load(memory_order_acquire);
+    }
+
+    // The caller keeps catalog alive while requests may still be rendering with it
+    void publishCatalog(const MessageCatalog* catalog) {
+        activeCatalog.store(catalog, memory_order_release);
+    }
+
+    // Number text with a catalog's separators. Built with to_chars rather than
+    // an iostream locale; English output matches the stream formatting.
+    struct FormattedNumber {
+        char text[80];
+        size_t size = 0;
+
+        operator string_view() const { return string_view(text, size); }
+    };
+
+    // Fixed with the given decimals
+    static FormattedNumber formatNumber(double value, int decimals, const MessageCatalog& catalog) {
+        char digits[64];
+        to_chars_result result = to_chars(digits, digits + sizeof(digits), value, chars_format::fixed, decimals);
+        if (result.ec != errc())
+            result = to_chars(digits, digits + sizeof(digits), value, chars_format::scientific, decimals);
+        return localizeNumber(digits, result.ptr, catalog);
+    }
+
+    // Six significant digits, as a stream prints by default
+    static FormattedNumber formatNumber(double value, const MessageCatalog& catalog) {
+        char digits[64];
+        to_chars_result result = to_chars(digits, digits + sizeof(digits), value, chars_format::general, 6);
+        return localizeNumber(digits, result.ptr, catalog);
+    }
+
+    static FormattedNumber formatNumber(int value, const MessageCatalog& catalog) {
+        char digits[64];
+        to_chars_result result = to_chars(digits, digits + sizeof(digits), value);
+        return localizeNumber(digits, result.ptr, catalog);
+    }
+
+    static FormattedNumber localizeNumber(const char* digits, const char* end, const MessageCatalog& catalog);
+
+    static constexpr RecommendationSection RECOMMENDATION_SECTION[RECOMMENDATION_COUNT] = {
+        SECTION_EXERCISE, SECTION_EXERCISE, SECTION_EXERCISE,
+        SECTION_EXERCISE, SECTION_EXERCISE, SECTION_EXERCISE,
+        SECTION_SLEEP, SECTION_SLEEP, SECTION_SLEEP, SECTION_SLEEP, SECTION_SLEEP,
+        SECTION_NUTRITION, SECTION_NUTRITION, SECTION_NUTRITION, SECTION_NUTRITION,
+        SECTION_NUTRITION, SECTION_NUTRITION, SECTION_NUTRITION, SECTION_NUTRITION,
+        SECTION_LIFESTYLE, SECTION_LIFESTYLE, SECTION_LIFESTYLE, SECTION_LIFESTYLE,
+        SECTION_LIFESTYLE
+    };
+    static_assert(nonDecreasing(RECOMMENDATION_SECTION),
+                  "recommendation IDs must be numbered in report section order");
+
+    // Recommendation bits given by each rule
+    static_assert(RECOMMENDATION_COUNT <= 32, "recommendation masks are 32 bits");
+    static constexpr uint32_t HIGH_BMI_RECOMMENDATIONS =
+        1u << REC_LOW_IMPACT_ACTIVITY | 1u << REC_150_MINUTES_ACTIVITY | 1u << REC_STRENGTH_TRAINING;
+    static constexpr uint32_t HEALTHY_BMI_RECOMMENDATIONS =
+        1u << REC_BALANCED_EXERCISE | 1u << REC_MIX_CARDIO_STRENGTH | 1u << REC_FLEXIBILITY;
+    static constexpr uint32_t SHORT_SLEEP_RECOMMENDATIONS =
+        1u << REC_INCREASE_SLEEP | 1u << REC_SLEEP_SCHEDULE | 1u << REC_BEDTIME_ROUTINE;
+    static constexpr uint32_t ENOUGH_SLEEP_RECOMMENDATIONS = 1u << REC_MAINTAIN_SLEEP | 1u << REC_SLEEP_QUALITY;
+    static constexpr uint32_t VEGETARIAN_RECOMMENDATIONS = 1u << REC_COMPLETE_PROTEIN | 1u << REC_B12_IRON;
+    static constexpr uint32_t VEGAN_RECOMMENDATIONS =
+        1u << REC_B12_SUPPLEMENT | 1u << REC_COMBINE_PROTEIN | 1u << REC_IRON_CALCIUM_VITAMIN_D;
+    static constexpr uint32_t OTHER_DIET_RECOMMENDATIONS =
+        1u << REC_LEAN_PROTEIN | 1u << REC_VEGETABLES | 1u << REC_LIMIT_PROCESSED;
+    static constexpr uint32_t SMOKING_RECOMMENDATIONS = 1u << REC_CESSATION_PROGRAMS | 1u << REC_CESSATION_AIDS;
+    static constexpr uint32_t ALCOHOL_RECOMMENDATIONS =
+        1u << REC_LIMIT_ALCOHOL | 1u << REC_ALCOHOL_FREE_DAYS | 1u << REC_STAY_HYDRATED;
+
+    // A profile's recommendations in report order
+    static const int MAX_RECOMMENDATIONS = 12;
+    struct Recommendations {
+        array<uint16_t, MAX_RECOMMENDATIONS> ids;
+        uint8_t count = 0;
+
+        void add(RecommendationId id) { ids[count++] = id; }
+    };
+
+    struct UserProfile {
+        int age;
+        string gender;
+        double height;  // in meters
+        double weight;  // in kg
+        string activityLevel;
+        int sleepHours;
+        string lifestyle;
+        string dietaryPref;
+        string goal = "maintain";
+        // Circumferences in cm for the US Navy body fat method; 0 if not measured
+        double waist = 0;
+        double neck = 0;
+        double hip = 0;
+        
+        // Calculated values
+        double bmi;
+        double bmr;
+        double dailyCalories;
+        double bodyFatPercent;
+        double leanBodyMass;  // in kg
+    };
+
+    // Returns the index of value in names, or count if it is not found
+    static uint8_t encodeName(const string& value, const char* const* names, uint8_t count) {
+        for (uint8_t i = 0; i < count; i++) {
+            if (value == names[i]) {
+                return i;
+            }
+        }
+        return count;
+    }
+
+    static uint8_t encodeGender(const string& gender) {
+        return encodeName(gender, GENDER_NAMES, GENDER_COUNT);
+    }
+
+    static uint8_t encodeActivityLevel(const string& level) {
+        return encodeName(level, ACTIVITY_NAMES, ACTIVITY_COUNT);
+    }
+
+    static uint8_t encodeLifestyle(const string& lifestyle) {
+        return encodeName(lifestyle, LIFESTYLE_NAMES, LIFESTYLE_COUNT);
+    }
+
+    static uint8_t encodeDietaryPref(const string& pref) {
+        return encodeName(pref, DIET_NAMES, DIET_COUNT);
+    }
+
+    static uint8_t encodeGoal(const string& goal) {
+        return encodeName(goal, GOAL_NAMES, GOAL_COUNT);
+    }
+
+    // Adult thresholds only; profiles are rated with the overload after
+    // GrowthChart, which also covers children
+    static BMICategory bmiCategory(double bmi, const WellnessConfig& cfg) {
+        const BMIThresholds& bmiThresholds = cfg.bmiThresholds;
+        if (bmi < bmiThresholds.underweight)
+            return BMI_UNDERWEIGHT;
+        else if (bmi < bmiThresholds.normal)
+            return BMI_NORMAL;
+        else if (bmi < bmiThresholds.overweight)
+            return BMI_OVERWEIGHT;
+        else
+            return BMI_OBESE;
+    }
+
+    // BMI-for-age reference for children, whose BMI categories come from
+    // percentiles rather than the adult thresholds. Holds the LMS parameters
+    // of a CDC growth chart per sex and whole month of age (see GrowthChartFile).
+    struct GrowthChart {
+        static const int FIRST_MONTH = 24, LAST_MONTH = 240;
+        static const int MONTHS = LAST_MONTH - FIRST_MONTH + 1;
+        static const int MIN_AGE = 2, MAX_AGE = 19;  // whole years the chart is used for
+        // Percentile cut-offs for underweight, overweight and obese
+        static constexpr double UNDERWEIGHT_PERCENTILE = 5, OVERWEIGHT_PERCENTILE = 85, OBESE_PERCENTILE = 95;
+
+        // Indexed by gender * MONTHS + month - FIRST_MONTH
+        array<double, GENDER_COUNT * MONTHS> l{}, m{}, s{};
+
+        static bool covers(int age) { return age >= MIN_AGE && age <= MAX_AGE; }
+
+        // Ages are whole years, so a child is taken to be in the middle of the year
+        static int ageMonths(int age) { return age * 12 + 6; }
+
+        static size_t index(uint8_t gender, int age) {
+            return static_cast<size_t>(gender) * MONTHS + ageMonths(age) - FIRST_MONTH;
+        }
+
+        // Box-Cox z-score: ((bmi / M)^L - 1) / (L * S), or ln(bmi / M) / S when L is 0
+        static double lmsZScore(double bmi, double l, double m, double s) {
+            double logRatio = log(bmi / m);
+            return l != 0 ? expm1(l * logRatio) / (l * s) : logRatio / s;
+        }
+
+        // NaN outside the chart's ages
+        double zScore(uint8_t gender, int age, double bmi) const {
+            if (!covers(age) || gender >= GENDER_COUNT)
+                return numeric_limits<double>::quiet_NaN();
+            size_t i = index(gender, age);
+            return lmsZScore(bmi, l[i], m[i], s[i]);
+        }
+
+        static double percentile(double z) {
+            return 50.0 * erfc(-z / sqrt(2.0));
+        }
+
+        static BMICategory category(double percentile) {
+            if (percentile < UNDERWEIGHT_PERCENTILE)
+                return BMI_UNDERWEIGHT;
+            if (percentile < OVERWEIGHT_PERCENTILE)
+                return BMI_NORMAL;
+            if (percentile < OBESE_PERCENTILE)
+                return BMI_OVERWEIGHT;
+            return BMI_OBESE;
+        }
+
+        // zScore() and percentile() over columns; percentile may be null.
+        // Rows outside the chart's ages get NaN.
+        void zScores(const uint8_t* age, const uint8_t* gender, const double* bmi, double* z,
+                     double* percentiles, size_t begin, size_t end) const;
+    };
+
+    // The chart used for children, or null to apply the adult thresholds to everyone
+    const GrowthChart* growthChart() const {
+        return activeGrowthChart.load(memory_order_acquire);
+    }
+
+    // The caller keeps chart alive while requests may still be using it
+    void publishGrowthChart(const GrowthChart* chart) {
+        activeGrowthChart.store(chart, memory_order_release);
+    }
+
+    // True when a profile is rated by BMI-for-age rather than the adult thresholds
+    static bool usesGrowthChart(const GrowthChart* chart, int age, uint8_t gender) {
+        return chart && GrowthChart::covers(age) && gender < GENDER_COUNT;
+    }
+
+    // The category every report, recommendation and aggregate uses: BMI-for-age
+    // percentile for a child the chart covers, the adult thresholds otherwise
+    static BMICategory bmiCategory(double bmi, int age, uint8_t gender, const WellnessConfig& cfg,
+                                   const GrowthChart* chart) {
+        if (usesGrowthChart(chart, age, gender))
+            return GrowthChart::category(GrowthChart::percentile(chart->zScore(gender, age, bmi)));
+        return bmiCategory(bmi, cfg);
+    }
+
+    // Prompts are localized; answers are still the English keywords.
+    // measurements also asks for the optional body circumferences.
+    UserProfile collectUserData(bool measurements = false) {
+        UserProfile profile;
+        const MessageCatalog& catalog = this->catalog();
+        
+        profile.age = getValidInput<int>(catalog.text(MSG_PROMPT_AGE), MIN_AGE, MAX_AGE, catalog);
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        
+        profile.gender = getValidStringInput(catalog.text(MSG_PROMPT_GENDER), isValidGender, catalog);
+        
+        profile.height = getValidMeasurement(catalog.text(MSG_PROMPT_HEIGHT), parseHeight,
+                                             MIN_HEIGHT, MAX_HEIGHT, catalog);
+        profile.weight = getValidMeasurement(catalog.text(MSG_PROMPT_WEIGHT), parseWeight,
+                                             MIN_WEIGHT, MAX_WEIGHT, catalog);
+        
+        profile.activityLevel = getValidStringInput(catalog.text(MSG_PROMPT_ACTIVITY),
+                                                    isValidActivityLevel, catalog);
+        
+        profile.sleepHours = getValidInput<int>(catalog.text(MSG_PROMPT_SLEEP),
+                                              MIN_SLEEP_HOURS, MAX_SLEEP_HOURS, catalog);
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        
+        profile.lifestyle = getValidStringInput(catalog.text(MSG_PROMPT_LIFESTYLE), isValidLifestyle, catalog);
+        
+        profile.dietaryPref = getValidStringInput(catalog.text(MSG_PROMPT_DIET), isValidDietaryPref, catalog);
+
+        if (!measurements)
+            return profile;
+
+        // Optional; the US Navy body fat method needs waist and neck, and hip for women
+        profile.waist = getOptionalMeasurement(catalog.text(MSG_PROMPT_WAIST), parseCircumference,
+                                               MIN_CIRCUMFERENCE, MAX_CIRCUMFERENCE, catalog);
+        if (profile.waist > 0) {
+            profile.neck = getOptionalMeasurement(catalog.text(MSG_PROMPT_NECK), parseCircumference,
+                                                  MIN_CIRCUMFERENCE, MAX_CIRCUMFERENCE, catalog);
+            if (profile.gender == "female")
+                profile.hip = getOptionalMeasurement(catalog.text(MSG_PROMPT_HIP), parseCircumference,
+                                                     MIN_CIRCUMFERENCE, MAX_CIRCUMFERENCE, catalog);
+        }
+
+        return profile;
+    }
+
+    // Macronutrients for a profile's diet, activity level and goal
+    static MacroGrams macroGrams(const UserProfile& profile, const WellnessConfig& cfg) {
+        uint8_t diet = min<uint8_t>(encodeDietaryPref(profile.dietaryPref), DIET_COUNT - 1);
+        uint8_t activity = min<uint8_t>(encodeActivityLevel(profile.activityLevel), ACTIVITY_COUNT - 1);
+        uint8_t goal = min<uint8_t>(encodeGoal(profile.goal), GOAL_COUNT - 1);
+        return macroGrams(cfg.macroProfile(diet, activity, goal), profile.dailyCalories, profile.weight);
+    }
+
+    // BMR shared by the scalar and batch metric paths
+    static double basalMetabolicRate(bool male, double weight, double height, int age) {
+        if (male) {
+            return 88.362 + (13.397 * weight) + 
+                   (4.799 * height * 100) - (5.677 * age);
+        } else {
+            return 447.593 + (9.247 * weight) + 
+                   (3.098 * height * 100) - (4.330 * age);
+        }
+    }
+
+    // Multiplier for an encoded activity level (NaN if unknown)
+    double activityMultiplier(uint8_t level) const {
+        const WellnessConfig& cfg = config();
+        if (level < cfg.activityMultipliers.size())
+            return cfg.activityMultipliers[level];
+        return numeric_limits<double>::quiet_NaN();
+    }
+
+    void calculateMetrics(UserProfile& profile) const {
+        calculateMetrics(profile, config());
+    }
+
+    // Whether the circumferences the US Navy method needs were measured
+    static bool hasCircumferences(bool male, double waist, double neck, double hip) {
+        return male ? (neck > 0 && waist > neck)
+                    : (neck > 0 && waist > 0 && hip > 0 && waist + hip > neck);
+    }
+
+    // US Navy circumference method, all lengths in cm
+    static double navyBodyFat(bool male, double heightCm, double waist, double neck, double hip) {
+        if (male) {
+            return 495.0 / (1.0324 - 0.19077 * log10(waist - neck) + 0.15456 * log10(heightCm)) - 450.0;
+        }
+        return 495.0 / (1.29579 - 0.35004 * log10(waist + hip - neck) + 0.22100 * log10(heightCm)) - 450.0;
+    }
+
+    // Deurenberg estimate from BMI, used when circumferences are missing.
+    // Children have their own fit, with different age and sex terms.
+    static double deurenbergBodyFat(bool male, double bmi, int age) {
+        double sex = male ? 1.0 : 0.0;
+        if (age < ADULT_AGE)
+            return 1.51 * bmi - 0.70 * age - 3.6 * sex + 1.4;
+        return 1.20 * bmi + 0.23 * age - 10.8 * sex - 5.4;
+    }
+
+    // Body fat percentage, limited to a physiologically plausible range
+    static double bodyFatPercent(bool male, double height, double bmi, int age,
+                                 double waist, double neck, double hip) {
+        double percent = hasCircumferences(male, waist, neck, hip)
+                             ? navyBodyFat(male, height * 100, waist, neck, hip)
+                             : deurenbergBodyFat(male, bmi, age);
+        return min(MAX_BODY_FAT_PERCENT, max(MIN_BODY_FAT_PERCENT, percent));
+    }
+
+    static constexpr double MIN_BODY_FAT_PERCENT = 2.0, MAX_BODY_FAT_PERCENT = 75.0;
+
+    static double katchMcArdle(double leanBodyMass) {
+        return 370.0 + 21.6 * leanBodyMass;
+    }
+
+    static void calculateMetrics(UserProfile& profile, const WellnessConfig& cfg);
+
+    void displayResults(const UserProfile& profile, ostream& out = cout) const {
+        displayResults(profile, out, config());
+    }
+
+    void displayResults(const UserProfile& profile, ostream& out, const WellnessConfig& cfg) const {
+        displayResults(profile, out, cfg, macroGrams(profile, cfg));
+    }
+
+    // Renders with macronutrient grams already computed (e.g. by the batch kernel)
+    void displayResults(const UserProfile& profile, ostream& out, const WellnessConfig& cfg,
+                        const MacroGrams& grams) const {
+        displayResults(profile, out, cfg, grams, catalog());
+    }
+
+    void displayResults(const UserProfile& profile, ostream& out, const WellnessConfig& cfg,
+                        const MacroGrams& grams, const MessageCatalog& catalog) const;
+
+    void provideRecommendations(const UserProfile& profile, ostream& out = cout) const {
+        provideRecommendations(profile, out, config(), catalog());
+    }
+
+    void provideRecommendations(const UserProfile& profile, ostream& out, const WellnessConfig& cfg,
+                                const MessageCatalog& catalog) const {
+        out << "\n";
+        catalog.write(out, MSG_RECOMMENDATIONS_TITLE);
+        out << "\n";
+        renderRecommendations(recommendations(profile, cfg, growthChart()), catalog, out);
+    }
+
+    // Text is looked up only here, so results can be kept as IDs and shown in any locale
+    static void renderRecommendations(const Recommendations& recs, const MessageCatalog& catalog,
+                                      ostream& out);
+
+    static Recommendations recommendations(const UserProfile& profile, const WellnessConfig& cfg,
+                                           const GrowthChart* chart) {
+        return recommendations(bmiCategory(profile.bmi, profile.age, encodeGender(profile.gender), cfg, chart),
+                               profile.sleepHours, encodeDietaryPref(profile.dietaryPref),
+                               encodeLifestyle(profile.lifestyle));
+    }
+
+    // Encoded form, shared with the columnar and C callers. IDs are numbered
+    // in report order, so the recommendations are the mask's set bits, lowest first.
+    static Recommendations recommendations(BMICategory category, int sleepHours, uint8_t diet,
+                                           uint8_t lifestyle) {
+        Recommendations recs;
+        for (uint32_t mask = recommendationMask(category, sleepHours, diet, lifestyle); mask != 0;
+             mask &= mask - 1)
+            recs.add(static_cast<RecommendationId>(__builtin_ctz(mask)));
+        return recs;
+    }
+
+    // Every recommendation rule at once, one bit per RecommendationId. The
+    // rules are combined with masks instead of branches so the batch kernel
+    // vectorizes. category comes from bmiCategory(), so children are rated
+    // by the growth chart here too.
+    static uint32_t recommendationMask(BMICategory category, int sleepHours, uint8_t diet, uint8_t lifestyle);
+
+private:
+    // Unit sizes in micrometers, exact in a double
+    static constexpr double MICROMETERS_PER_METER = 1e6, MICROMETERS_PER_CM = 1e4;
+    static constexpr double MICROMETERS_PER_INCH = 25400, MICROMETERS_PER_FOOT = 304800;
+    static constexpr double KG_PER_POUND = 0.45359237;
+
+    // Length in the base unit of the given size; numbers already in the base
+    // unit are returned unchanged
+    static bool parseLength(const string& text, double baseMicrometers, double& value);
+
+    // Micrometers per unit; 0 for no unit, -1 if unknown
+    static double lengthUnit(const string& unit) {
+        if (unit.empty()) return 0;
+        if (unit == "m") return MICROMETERS_PER_METER;
+        if (unit == "cm") return MICROMETERS_PER_CM;
+        if (unit == "in" || unit == "inch" || unit == "inches" || unit == "\"") return MICROMETERS_PER_INCH;
+        if (unit == "ft" || unit == "foot" || unit == "feet" || unit == "'") return MICROMETERS_PER_FOOT;
+        return -1;
+    }
+
+    static bool parseNumber(const char*& p, double& value) {
+        char* end;
+        value = strtod(p, &end);
+        if (end == p)
+            return false;
+        p = end;
+        return true;
+    }
+
+    // A quote mark or a run of letters, lowercased
+    static string parseUnit(const char*& p);
+
+    static bool atEnd(const char* p) {
+        while (*p == ' ' || *p == '\t' || *p == '\r')
+            p++;
+        return *p == '\0';
+    }
+
+    // Reads a whole line, so a measurement can include spaces and a unit
+    static double getValidMeasurement(const char* prompt, bool (*parse)(const string&, double&),
+                                      double min_value, double max_value, const MessageCatalog& catalog) {
+        string input;
+        double value;
+        while (true) {
+            cout << prompt << " " << flush;
+            if (!getline(cin, input))
+                throw runtime_error("input ended before all answers were given");
+            if (parse(input, value) && value >= min_value && value <= max_value)
+                return value;
+            catalog.write(cout, MSG_INVALID_RANGE,
+                          {formatNumber(min_value, catalog), formatNumber(max_value, catalog)});
+            cout << "\n";
+        }
+    }
+
+    // getValidMeasurement() where an empty answer or the end of input skips
+    // the measurement and gives 0
+    static double getOptionalMeasurement(const char* prompt, bool (*parse)(const string&, double&),
+                                         double min_value, double max_value, const MessageCatalog& catalog) {
+        string input;
+        double value;
+        while (true) {
+            cout << prompt << " " << flush;
+            if (!getline(cin, input) || atEnd(input.c_str()))
+                return 0.0;
+            if (parse(input, value) && value >= min_value && value <= max_value)
+                return value;
+            catalog.write(cout, MSG_INVALID_RANGE,
+                          {formatNumber(min_value, catalog), formatNumber(max_value, catalog)});
+            cout << "\n";
+        }
+    }
+
+    template<typename T>
+    static T getValidInput(const char* prompt, T min_value, T max_value, const MessageCatalog& catalog) {
+        T value;
+        while (true) {
+            cout << prompt << " " << flush;
+            if (cin >> value && value >= min_value && value <= max_value) {
+                break;
+            }
+            if (cin.eof())
+                throw runtime_error("input ended before all answers were given");
+            catalog.write(cout, MSG_INVALID_RANGE,
+                          {formatNumber(min_value, catalog), formatNumber(max_value, catalog)});
+            cout << "\n";
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        }
+        return value;
+    }
+
+    static string getValidStringInput(const char* prompt, bool (*validationFunc)(const string&),
+                                      const MessageCatalog& catalog) {
+        string input;
+        while (true) {
+            cout << prompt << " " << flush;
+            if (!getline(cin, input))
+                throw runtime_error("input ended before all answers were given");
+            if (validationFunc(input)) {
+                transform(input.begin(), input.end(), input.begin(), ::tolower);
+                return input;
+            }
+            catalog.write(cout, MSG_INVALID_CHOICE);
+            cout << "\n";
+        }
+    }
+
+    atomic<const WellnessConfig*> activeConfig{&defaultConfig()};
+    atomic<const MessageCatalog*> activeCatalog{&ENGLISH_CATALOG};
+    atomic<const GrowthChart*> activeGrowthChart{nullptr};
+};
+
+// Reads WellnessConfig from "key = value" lines; '#' starts a comment.
+// Keys not present keep their compiled-in defaults:
+//   bmi.underweight, bmi.normal, bmi.overweight
+//   macros.carbs, macros.protein, macros.fats
+//   activity.sedentary, activity.lightly active, ...
+//   bmr.formula (standard or katch-mcardle)
+class ConfigFile {
+public:
+    typedef WellnessBot::WellnessConfig WellnessConfig;
+
+    static WellnessConfig parse(const string& text);
+
+    static WellnessConfig load(const string& path) {
+        ifstream in(path);
+        if (!in)
+            throw runtime_error("Cannot read config file: " + path);
+        ostringstream text;
+        text << in.rdbuf();
+        return parse(text.str());
+    }
+
+private:
+    static string where(int lineNumber) {
+        return "Config line " + to_string(lineNumber) + ": ";
+    }
+
+    static string trim(const string& value) {
+        size_t first = value.find_first_not_of(" \t\r");
+        if (first == string::npos)
+            return "";
+        size_t last = value.find_last_not_of(" \t\r");
+        return value.substr(first, last - first + 1);
+    }
+
+    static double* fieldFor(WellnessConfig& config, const string& key);
+
+    static void validate(const WellnessConfig& config);
+};
+
+// Per-locale message catalogs. A catalog source has "English text =
+// translation" lines, plus "locale = <name>" and optional "decimal = <char>"
+// and "group = <char>|space|none" lines; '#' at the start of a line starts a
+// comment. compile() turns a source into a binary table that a
+// MessageCatalogFile maps read-only and uses in place, so loading a locale
+// does no parsing or copying.
+class MessageCatalogFile {
+public:
+    typedef WellnessBot::MessageCatalog MessageCatalog;
+
+    // Native byte order; followed by uint16_t offsets[messageCount], padded
+    // to 4 bytes, then stringsSize bytes of NUL-terminated strings
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t messageCount;
+        uint32_t stringsSize;
+        char locale[16];
+        char decimalSeparator;
+        char groupSeparator;
+        char reserved[2];
+    };
+
+    explicit MessageCatalogFile(const string& path);
+
+    ~MessageCatalogFile() {
+        munmap(const_cast<char*>(data), size);
+    }
+
+    MessageCatalogFile(const MessageCatalogFile&) = delete;
+    MessageCatalogFile& operator=(const MessageCatalogFile&) = delete;
+
+    const MessageCatalog& catalog() const { return catalogView; }
+
+    // Builds the binary table; messages the source leaves out keep their
+    // English text and are counted in untranslated
+    static string compile(const string& text, size_t& untranslated);
+
+    static const uint32_t FORMAT_VERSION = 1;
+
+private:
+    static constexpr char MAGIC[4] = {'W', 'B', 'M', 'C'};
+
+    const char* data = nullptr;
+    size_t size = 0;
+    MessageCatalog catalogView = {};
+
+    static size_t stringsOffset(uint32_t messageCount) {
+        return (sizeof(Header) + messageCount * sizeof(uint16_t) + 3) & ~size_t(3);
+    }
+
+    // Checks everything a lookup relies on, so text() never reads outside the mapping
+    bool validate() const;
+
+    static size_t placeholders(const string& text) {
+        size_t count = 0;
+        for (size_t at = text.find("{}"); at != string::npos; at = text.find("{}", at + 2))
+            count++;
+        return count;
+    }
+
+    static string where(int lineNumber) {
+        return "Catalog line " + to_string(lineNumber) + ": ";
+    }
+
+    static string trim(const string& value) {
+        size_t first = value.find_first_not_of(" \t");
+        if (first == string::npos)
+            return "";
+        size_t last = value.find_last_not_of(" \t");
+        return value.substr(first, last - first + 1);
+    }
+};
+
+// Loads a BMI-for-age growth chart in the CDC CSV layout (bmiagerev.csv):
+// a header naming the Sex (1 male, 2 female), Agemos, L, M and S columns,
+// then one row per sex and age in months. Other columns and repeated header
+// lines are ignored. Rows are interpolated linearly onto whole months.
+class GrowthChartFile {
+public:
+    typedef WellnessBot::GrowthChart GrowthChart;
+
+    static GrowthChart parse(const string& text);
+
+    static GrowthChart load(const string& path) {
+        ifstream in(path);
+        if (!in)
+            throw runtime_error("Cannot read growth chart: " + path);
+        ostringstream text;
+        text << in.rdbuf();
+        return parse(text.str());
+    }
+
+private:
+    enum Column { SEX, AGEMOS, L, M, S, COLUMN_COUNT };
+    static constexpr const char* COLUMN_NAMES[COLUMN_COUNT] = {"sex", "agemos", "l", "m", "s"};
+
+    static vector<string> split(const string& line);
+
+    static string lower(string value) {
+        transform(value.begin(), value.end(), value.begin(), ::tolower);
+        return value;
+    }
+
+    static string where(int lineNumber) {
+        return "Growth chart line " + to_string(lineNumber) + ": ";
+    }
+};
+
+// Page backing for large buffers (profile columns, report buffers, sketch state)
+enum class HugePages { OFF, TRANSPARENT, PAGES_2MB, PAGES_1GB };
+
+// Allocates buffers of 2 MB or more from anonymous mappings backed by huge
+// pages. Explicit MAP_HUGETLB pages fall back to transparent huge pages
+// (madvise) when the kernel has none reserved; smaller buffers use new.
+class HugePageArena {
+public:
+    static const size_t PAGE_2MB = size_t(1) << 21;
+    static const size_t PAGE_1GB = size_t(1) << 30;
+
+    // Mode used by default-constructed HugePageAllocators
+    static atomic<HugePages>& defaultMode() {
+        static atomic<HugePages> mode{HugePages::OFF};
+        return mode;
+    }
+
+    // Running totals of bytes mapped with explicit huge pages and with the
+    // fallback since the caller last reset them. Unmapping does not subtract:
+    // deallocate() cannot tell which kind a mapping was.
+    static atomic<size_t>& hugetlbBytesMapped() {
+        static atomic<size_t> bytes{0};
+        return bytes;
+    }
+
+    static atomic<size_t>& fallbackBytesMapped() {
+        static atomic<size_t> bytes{0};
+        return bytes;
+    }
+
+    static bool parseMode(const string& name, HugePages& mode);
+
+    static void* allocate(size_t bytes, HugePages mode);
+
+    static void deallocate(void* p, size_t bytes, HugePages mode) {
+        if (!usesMapping(bytes, mode)) {
+            ::operator delete(p);
+            return;
+        }
+        // Both kinds of mapping share the same length, so the caller's size
+        // is enough to unmap either one
+        munmap(p, mappingLength(bytes, mode));
+    }
+
+private:
+    static bool usesMapping(size_t bytes, HugePages mode) {
+        return mode != HugePages::OFF && bytes >= PAGE_2MB;
+    }
+
+    static size_t mappingLength(size_t bytes, HugePages mode) {
+        size_t page = mode == HugePages::PAGES_1GB && bytes >= PAGE_1GB ? PAGE_1GB : PAGE_2MB;
+        return (bytes + page - 1) / page * page;
+    }
+
+    static void* mapHugetlb(size_t length, int pageShift);
+};
+
+template<typename T>
+class HugePageAllocator {
+public:
+    typedef T value_type;
+    typedef true_type propagate_on_container_copy_assignment;
+    typedef true_type propagate_on_container_move_assignment;
+    typedef true_type propagate_on_container_swap;
+
+    HugePages mode;
+
+    HugePageAllocator() : mode(HugePageArena::defaultMode().load()) {}
+    explicit HugePageAllocator(HugePages mode) : mode(mode) {}
+    template<typename U>
+    HugePageAllocator(const HugePageAllocator<U>& other) : mode(other.mode) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(HugePageArena::allocate(n * sizeof(T), mode));
+    }
+
+    void deallocate(T* p, size_t n) {
+        HugePageArena::deallocate(p, n * sizeof(T), mode);
+    }
+
+    template<typename U>
+    bool operator==(const HugePageAllocator<U>& other) const { return mode == other.mode; }
+    template<typename U>
+    bool operator!=(const HugePageAllocator<U>& other) const { return mode != other.mode; }
+};
+
+// Storage type for profile columns and other large buffers
+template<typename T>
+using Column = vector<T, HugePageAllocator<T>>;
+
+// Materialized cohort aggregates (BMI category counts and dailyCalories sums
+// per activity level and diet), maintained incrementally as profiles change.
+// Readers take a lock-free, consistent snapshot through a sequence counter.
+class CohortViews {
+public:
+    typedef WellnessBot::UserProfile UserProfile;
+    typedef WellnessBot::WellnessConfig WellnessConfig;
+    typedef WellnessBot::GrowthChart GrowthChart;
+
+    static const int CELL_COUNT = WellnessBot::ACTIVITY_COUNT * WellnessBot::DIET_COUNT *
+                                  WellnessBot::BMI_CATEGORY_COUNT;
+
+    // One profile's contribution to a cell
+    struct Delta {
+        int cell;
+        int64_t milliCalories;
+    };
+
+    struct Snapshot {
+        uint64_t version = 0;
+        // Indexed by cellIndex(activity, diet, bmiCategory)
+        array<int64_t, CELL_COUNT> counts{};
+        array<int64_t, CELL_COUNT> milliCalories{};  // dailyCalories sums in 1/1000 kcal
+
+        int64_t count(int activity, int diet, int category) const {
+            return counts[cellIndex(activity, diet, category)];
+        }
+
+        int64_t bmiCategoryCount(int category) const {
+            int64_t total = 0;
+            for (int a = 0; a < WellnessBot::ACTIVITY_COUNT; a++)
+                for (int d = 0; d < WellnessBot::DIET_COUNT; d++)
+                    total += count(a, d, category);
+            return total;
+        }
+
+        double averageCalories(int activity, int diet) const {
+            int64_t n = 0, sum = 0;
+            for (int c = 0; c < WellnessBot::BMI_CATEGORY_COUNT; c++) {
+                n += counts[cellIndex(activity, diet, c)];
+                sum += milliCalories[cellIndex(activity, diet, c)];
+            }
+            return n == 0 ? 0.0 : (sum / 1000.0) / n;
+        }
+
+        bool sameAggregates(const Snapshot& other) const {
+            return counts == other.counts && milliCalories == other.milliCalories;
+        }
+
+        // Categorized under cfg and chart, which the caller reads once for a
+        // whole batch. False, adding nothing, for an unknown activity level or diet.
+        bool add(const WellnessConfig& cfg, const GrowthChart* chart, const UserProfile& profile) {
+            Delta delta;
+            if (!deltaFor(cfg, chart, profile, delta))
+                return false;
+            add(delta);
+            return true;
+        }
+
+        // add() for one row of a columnar store
+        bool addEncoded(const WellnessConfig& cfg, const GrowthChart* chart, uint8_t age, uint8_t gender,
+                        uint8_t activity, uint8_t diet, double bmi, double dailyCalories) {
+            Delta delta;
+            if (!deltaFor(cfg, chart, age, gender, activity, diet, bmi, dailyCalories, delta))
+                return false;
+            add(delta);
+            return true;
+        }
+
+        void add(const Delta& delta) {
+            counts[delta.cell] += 1;
+            milliCalories[delta.cell] += delta.milliCalories;
+        }
+
+        void merge(const Snapshot& other) {
+            for (int i = 0; i < CELL_COUNT; i++) {
+                counts[i] += other.counts[i];
+                milliCalories[i] += other.milliCalories[i];
+            }
+        }
+
+        void serialize(string& out) const;
+        static Snapshot deserialize(const string& in, size_t& pos);
+    };
+
+    explicit CohortViews(const WellnessBot& bot) : bot(bot) {
+        for (int i = 0; i < CELL_COUNT; i++) {
+            counts[i].store(0, memory_order_relaxed);
+            milliCalories[i].store(0, memory_order_relaxed);
+        }
+    }
+
+    // Profiles must have their metrics calculated before being applied. A
+    // profile with an unknown activity level or diet is rejected: the call
+    // returns false and the views are left unchanged.
+    //
+    // Each user's cell and contribution are recorded when applied, and
+    // update() and remove() retract exactly that. The BMI category is taken
+    // under the thresholds current at the time, so a config reload between
+    // insert and remove cannot move the retraction to another cell.
+
+    // False if userId is already in the views
+    bool insert(uint64_t userId, const UserProfile& profile);
+
+    // False if userId is not in the views
+    bool update(uint64_t userId, const UserProfile& newProfile);
+
+    bool remove(uint64_t userId);
+
+    // Lock-free for readers: retries only while a writer is mid-update
+    Snapshot snapshot() const;
+
+    // Recomputes the aggregates from scratch, splitting the population across threads
+    static Snapshot rebuild(const WellnessBot& bot, const vector<UserProfile>& population,
+                            unsigned threadCount);
+
+    // Checks the incrementally maintained views against a full rebuild. A
+    // rebuild classifies with the current thresholds, so after a reload that
+    // moves a BMI boundary the two differ until the views are rebuilt.
+    bool verify(const vector<UserProfile>& population, unsigned threadCount) const {
+        return snapshot().sameAggregates(rebuild(bot, population, threadCount));
+    }
+
+    static int cellIndex(int activity, int diet, int category) {
+        return (activity * WellnessBot::DIET_COUNT + diet) * WellnessBot::BMI_CATEGORY_COUNT + category;
+    }
+
+private:
+
+    const WellnessBot& bot;
+    mutex writeMutex;
+    unordered_map<uint64_t, Delta> applied;  // by user ID, guarded by writeMutex
+    atomic<uint64_t> sequence{0};
+    array<atomic<int64_t>, CELL_COUNT> counts;
+    array<atomic<int64_t>, CELL_COUNT> milliCalories;
+
+    bool deltaFor(const UserProfile& profile, Delta& delta) const {
+        return deltaFor(bot.config(), bot.growthChart(), profile, delta);
+    }
+
+    static bool deltaFor(const WellnessConfig& cfg, const GrowthChart* chart, const UserProfile& profile,
+                         Delta& delta) {
+        return deltaFor(cfg, chart, static_cast<uint8_t>(profile.age), WellnessBot::encodeGender(profile.gender),
+                        WellnessBot::encodeActivityLevel(profile.activityLevel),
+                        WellnessBot::encodeDietaryPref(profile.dietaryPref), profile.bmi,
+                        profile.dailyCalories, delta);
+    }
+
+    // Calories are kept in fixed point so retractions cancel exactly. False
+    // for a code with no cell.
+    static bool deltaFor(const WellnessConfig& cfg, const GrowthChart* chart, uint8_t age, uint8_t gender,
+                         uint8_t activity, uint8_t diet, double bmi, double dailyCalories, Delta& delta) {
+        if (activity >= WellnessBot::ACTIVITY_COUNT || diet >= WellnessBot::DIET_COUNT)
+            return false;
+        delta.cell = cellIndex(activity, diet, WellnessBot::bmiCategory(bmi, age, gender, cfg, chart));
+        delta.milliCalories = llround(dailyCalories * 1000.0);
+        return true;
+    }
+
+    void beginWrite() {
+        sequence.fetch_add(1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+    }
+
+    void endWrite() {
+        sequence.fetch_add(1, memory_order_release);
+    }
+
+    void apply(const Delta& delta, int64_t sign) {
+        counts[delta.cell].fetch_add(sign, memory_order_relaxed);
+        milliCalories[delta.cell].fetch_add(sign * delta.milliCalories, memory_order_relaxed);
+    }
+};
+
+// Batch hashing for sketch updates. Both 32-bit halves of each 64-bit hash
+// come from murmur3 finalizers, so eight keys hash per AVX2 instruction.
+class SketchHash {
+public:
+    static uint32_t fmix32(uint32_t h) {
+        h ^= h >> 16;
+        h *= 0x85ebca6bu;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35u;
+        h ^= h >> 16;
+        return h;
+    }
+
+    static uint64_t hash64(uint64_t key, uint32_t seed) {
+        uint32_t lo = static_cast<uint32_t>(key);
+        uint32_t hi = static_cast<uint32_t>(key >> 32);
+        uint32_t a = fmix32((lo * 0xcc9e2d51u) ^ hi ^ seed);
+        uint32_t b = fmix32((hi * 0x1b873593u) ^ a ^ (seed * 0x9e3779b9u));
+        return (static_cast<uint64_t>(b) << 32) | a;
+    }
+
+    // out[i] = hash64(keys[i], seed)
+    static void hashBatch(const uint64_t* keys, size_t count, uint32_t seed, uint64_t* out);
+
+private:
+#ifdef __AVX2__
+    static __m256i fmix32x8(__m256i h) {
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+        h = _mm256_mullo_epi32(h, _mm256_set1_epi32(static_cast<int>(0x85ebca6bu)));
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 13));
+        h = _mm256_mullo_epi32(h, _mm256_set1_epi32(static_cast<int>(0xc2b2ae35u)));
+        return _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+    }
+#endif
+};
+
+// Little-endian byte encoding shared by the sketch serializers
+class SketchCodec {
+public:
+    static void putU32(string& out, uint32_t value) {
+        for (int i = 0; i < 4; i++)
+            out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+
+    static void putU64(string& out, uint64_t value) {
+        for (int i = 0; i < 8; i++)
+            out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+
+    static uint32_t getU32(const string& in, size_t& pos) {
+        need(in, pos, 4);
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++)
+            value |= static_cast<uint32_t>(static_cast<uint8_t>(in[pos++])) << (8 * i);
+        return value;
+    }
+
+    static uint64_t getU64(const string& in, size_t& pos) {
+        need(in, pos, 8);
+        uint64_t value = 0;
+        for (int i = 0; i < 8; i++)
+            value |= static_cast<uint64_t>(static_cast<uint8_t>(in[pos++])) << (8 * i);
+        return value;
+    }
+
+    static void need(const string& in, size_t pos, size_t bytes) {
+        if (pos + bytes > in.size())
+            throw runtime_error("Truncated sketch data");
+    }
+};
+
+inline void CohortViews::Snapshot::serialize(string& out) const {
+    SketchCodec::putU32(out, CELL_COUNT);
+    for (int i = 0; i < CELL_COUNT; i++) {
+        SketchCodec::putU64(out, static_cast<uint64_t>(counts[i]));
+        SketchCodec::putU64(out, static_cast<uint64_t>(milliCalories[i]));
+    }
+}
+
+inline CohortViews::Snapshot CohortViews::Snapshot::deserialize(const string& in, size_t& pos) {
+    if (SketchCodec::getU32(in, pos) != CELL_COUNT)
+        throw runtime_error("Cohort aggregate layout mismatch");
+    Snapshot snap;
+    for (int i = 0; i < CELL_COUNT; i++) {
+        snap.counts[i] = static_cast<int64_t>(SketchCodec::getU64(in, pos));
+        snap.milliCalories[i] = static_cast<int64_t>(SketchCodec::getU64(in, pos));
+    }
+    return snap;
+}
+
+// HyperLogLog distinct counter with 2^precision one-byte registers
+class HyperLogLog {
+public:
+    explicit HyperLogLog(int precision = 14) : precision(precision) {
+        if (precision < 4 || precision > 18)
+            throw invalid_argument("HyperLogLog precision must be between 4 and 18");
+        registers.assign(size_t(1) << precision, 0);
+    }
+
+    void addHash(uint64_t hash) {
+        size_t index = hash >> (64 - precision);
+        uint64_t rest = (hash << precision) | (uint64_t(1) << (precision - 1));
+        uint8_t rank = static_cast<uint8_t>(__builtin_clzll(rest) + 1);
+        if (rank > registers[index])
+            registers[index] = rank;
+    }
+
+    double estimate() const;
+
+    void merge(const HyperLogLog& other) {
+        if (other.precision != precision)
+            throw invalid_argument("Cannot merge HyperLogLog sketches of different precision");
+        for (size_t i = 0; i < registers.size(); i++)
+            registers[i] = max(registers[i], other.registers[i]);
+    }
+
+    void serialize(string& out) const {
+        SketchCodec::putU32(out, static_cast<uint32_t>(precision));
+        out.append(reinterpret_cast<const char*>(registers.data()), registers.size());
+    }
+
+    static HyperLogLog deserialize(const string& in, size_t& pos) {
+        HyperLogLog hll(static_cast<int>(SketchCodec::getU32(in, pos)));
+        SketchCodec::need(in, pos, hll.registers.size());
+        memcpy(hll.registers.data(), in.data() + pos, hll.registers.size());
+        pos += hll.registers.size();
+        return hll;
+    }
+
+private:
+    int precision;
+    Column<uint8_t> registers;
+};
+
+// Count-Min frequency sketch; estimates never undercount
+class CountMinSketch {
+public:
+    static const int MAX_DEPTH = 16;
+    static const int MAX_WIDTH = 1 << 24;
+
+    CountMinSketch(int depth = 4, int width = 2048) : depth(depth), width(width) {
+        if (depth < 1 || depth > MAX_DEPTH || width < 1 || width > MAX_WIDTH)
+            throw invalid_argument("Invalid Count-Min sketch dimensions");
+        counters.assign(static_cast<size_t>(depth) * width, 0);
+    }
+
+    // hashes must hold one precomputed hash per row (see rowHash)
+    void addHashes(const uint64_t* hashes, uint64_t amount = 1) {
+        for (int row = 0; row < depth; row++)
+            counters[static_cast<size_t>(row) * width + hashes[row] % width] += amount;
+    }
+
+    void add(uint64_t key, uint64_t amount = 1) {
+        uint64_t hashes[16];
+        for (int row = 0; row < depth; row++)
+            hashes[row] = rowHash(key, row);
+        addHashes(hashes, amount);
+    }
+
+    uint64_t estimate(uint64_t key) const {
+        uint64_t best = numeric_limits<uint64_t>::max();
+        for (int row = 0; row < depth; row++)
+            best = min(best, counters[static_cast<size_t>(row) * width + rowHash(key, row) % width]);
+        return best;
+    }
+
+    void merge(const CountMinSketch& other) {
+        if (other.depth != depth || other.width != width)
+            throw invalid_argument("Cannot merge Count-Min sketches of different dimensions");
+        for (size_t i = 0; i < counters.size(); i++)
+            counters[i] += other.counters[i];
+    }
+
+    void serialize(string& out) const {
+        SketchCodec::putU32(out, static_cast<uint32_t>(depth));
+        SketchCodec::putU32(out, static_cast<uint32_t>(width));
+        for (uint64_t c : counters)
+            SketchCodec::putU64(out, c);
+    }
+
+    // Dimensions come from checkpoint and aggregate files, so they are
+    // checked against the limits and the bytes left before allocating
+    static CountMinSketch deserialize(const string& in, size_t& pos);
+
+    static uint64_t rowHash(uint64_t key, int row) {
+        return SketchHash::hash64(key, ROW_SEED + static_cast<uint32_t>(row));
+    }
+
+    static const uint32_t ROW_SEED = 0x5bd1e995u;
+
+    int rows() const { return depth; }
+
+private:
+    int depth;
+    int width;
+    Column<uint64_t> counters;
+};
+
+// Per-cohort distinct user counts and (activity, diet, lifestyle) frequencies
+// over a stream of profile events, mergeable across shards and processes.
+class ProfileSketches {
+public:
+    typedef WellnessBot::UserProfile UserProfile;
+
+    static const int COHORT_COUNT = WellnessBot::ACTIVITY_COUNT * WellnessBot::DIET_COUNT *
+                                    WellnessBot::LIFESTYLE_COUNT;
+
+    explicit ProfileSketches(int hllPrecision = 12, int cmsDepth = 4, int cmsWidth = 2048)
+        : frequencies(cmsDepth, cmsWidth) {
+        cohortUsers.reserve(COHORT_COUNT);
+        for (int i = 0; i < COHORT_COUNT; i++)
+            cohortUsers.emplace_back(hllPrecision);
+    }
+
+    static int cohortKey(uint8_t activity, uint8_t diet, uint8_t lifestyle) {
+        return (activity * WellnessBot::DIET_COUNT + diet) * WellnessBot::LIFESTYLE_COUNT + lifestyle;
+    }
+
+    // Ingestion path: encodes and hashes events in blocks, then updates the
+    // sketches. A profile with an unknown categorical field is skipped, like
+    // in the cohort views; returns how many were skipped.
+    size_t ingest(const uint64_t* userIds, const UserProfile* profiles, size_t count);
+
+    double distinctUsers(int cohort) const {
+        return cohortUsers.at(cohort).estimate();
+    }
+
+    uint64_t combinationCount(int cohort) const {
+        return frequencies.estimate(static_cast<uint64_t>(cohort));
+    }
+
+    // The k most frequent (activity, diet, lifestyle) cohort keys, most frequent first
+    vector<pair<int, uint64_t>> topCombinations(size_t k) const;
+
+    void merge(const ProfileSketches& other) {
+        for (int c = 0; c < COHORT_COUNT; c++)
+            cohortUsers[c].merge(other.cohortUsers[c]);
+        frequencies.merge(other.frequencies);
+    }
+
+    string serialize() const {
+        string out = "WBSK";
+        SketchCodec::putU32(out, FORMAT_VERSION);
+        SketchCodec::putU32(out, COHORT_COUNT);
+        for (const auto& hll : cohortUsers)
+            hll.serialize(out);
+        frequencies.serialize(out);
+        return out;
+    }
+
+    static ProfileSketches deserialize(const string& in);
+
+    static const uint32_t FORMAT_VERSION = 1;
+
+private:
+    static const uint32_t USER_SEED = 0x2f6b9a1du;
+
+    vector<HyperLogLog> cohortUsers;
+    CountMinSketch frequencies;
+
+    void ingestEncoded(const uint64_t* userIds, const uint64_t* cohorts, size_t n,
+                       uint64_t* userHashes, uint64_t (*rowHashes)[256]);
+};
+
+// A profile in 16 bytes, for in-memory populations of 100M+ users. Codes
+// share one 32-bit word; height, weight and circumferences are 16-bit fixed
+// point at a finer step than input needs (0.1 mm, 10 g, 0.01 cm), so any
+// value given with at most that many decimals unpacks to exactly the double
+// it was parsed as. Metrics are not stored: unpack into ProfileColumns and
+// run the kernels there.
+struct alignas(16) PackedProfile {
+    typedef WellnessBot::UserProfile UserProfile;
+
+    // Fixed-point steps per meter, kg and cm
+    static constexpr double HEIGHT_UNITS = 10000.0;
+    static constexpr double WEIGHT_UNITS = 100.0;
+    static constexpr double CIRCUMFERENCE_UNITS = 100.0;
+
+    // Field positions within codes
+    static const int AGE_SHIFT = 0, SLEEP_SHIFT = 7, GENDER_SHIFT = 12, ACTIVITY_SHIFT = 13;
+    static const int LIFESTYLE_SHIFT = 15, DIET_SHIFT = 17, GOAL_SHIFT = 19;
+    static const uint32_t AGE_MASK = 0x7f, SLEEP_MASK = 0x1f, GENDER_MASK = 0x1, CODE_MASK = 0x3;
+
+    uint16_t height;   // 0.1 mm
+    uint16_t weight;   // 10 g
+    uint16_t waist;    // 0.01 cm, 0 if not measured
+    uint16_t neck;
+    uint16_t hip;
+    uint16_t reserved;
+    uint32_t codes;
+
+    uint8_t age() const { return field(AGE_SHIFT, AGE_MASK); }
+    uint8_t sleepHours() const { return field(SLEEP_SHIFT, SLEEP_MASK); }
+    uint8_t gender() const { return field(GENDER_SHIFT, GENDER_MASK); }
+    uint8_t activityLevel() const { return field(ACTIVITY_SHIFT, CODE_MASK); }
+    uint8_t lifestyle() const { return field(LIFESTYLE_SHIFT, CODE_MASK); }
+    uint8_t dietaryPref() const { return field(DIET_SHIFT, CODE_MASK); }
+    uint8_t goal() const { return field(GOAL_SHIFT, CODE_MASK); }
+
+    // Division rather than multiplying by the step, so decimal inputs come back exact
+    double heightMeters() const { return height / HEIGHT_UNITS; }
+    double weightKg() const { return weight / WEIGHT_UNITS; }
+    double waistCm() const { return waist / CIRCUMFERENCE_UNITS; }
+    double neckCm() const { return neck / CIRCUMFERENCE_UNITS; }
+    double hipCm() const { return hip / CIRCUMFERENCE_UNITS; }
+
+    // False, leaving packed unspecified, if a field is outside the ranges
+    // input accepts or a categorical is unknown
+    static bool pack(const UserProfile& profile, PackedProfile& packed);
+
+    // Same from encoded fields, as ProfileColumns holds them
+    static bool pack(uint8_t age, uint8_t sleepHours, uint8_t gender, uint8_t activityLevel,
+                     uint8_t lifestyle, uint8_t dietaryPref, uint8_t goal, double height,
+                     double weight, double waist, double neck, double hip, PackedProfile& packed);
+
+    // Input fields only; calculated values are left for calculateMetrics
+    UserProfile unpack() const;
+
+    bool operator==(const PackedProfile& other) const {
+        return memcmp(this, &other, sizeof(PackedProfile)) == 0;
+    }
+
+private:
+    uint8_t field(int shift, uint32_t mask) const { return static_cast<uint8_t>(codes >> shift & mask); }
+
+    static bool circumferenceInRange(double value) {
+        return value == 0 ||
+               (value >= WellnessBot::MIN_CIRCUMFERENCE && value <= WellnessBot::MAX_CIRCUMFERENCE);
+    }
+
+    // Range-checked by the caller, so the result always fits
+    static uint16_t quantize(double value, double units) {
+        return static_cast<uint16_t>(lround(value * units));
+    }
+};
+
+static_assert(sizeof(PackedProfile) == 16, "PackedProfile must stay 16 bytes");
+static_assert(WellnessBot::MAX_AGE <= PackedProfile::AGE_MASK &&
+              WellnessBot::MAX_SLEEP_HOURS <= PackedProfile::SLEEP_MASK &&
+              WellnessBot::MAX_HEIGHT * PackedProfile::HEIGHT_UNITS <= 65535 &&
+              WellnessBot::MAX_WEIGHT * PackedProfile::WEIGHT_UNITS <= 65535 &&
+              WellnessBot::MAX_CIRCUMFERENCE * PackedProfile::CIRCUMFERENCE_UNITS <= 65535,
+              "input ranges must fit PackedProfile fields");
+
+// Columnar (structure-of-arrays) profile store with categoricals encoded as
+// WellnessBot codes. Rows are grouped into fixed-size blocks for zone maps.
+class ProfileColumns {
+public:
+    typedef WellnessBot::UserProfile UserProfile;
+
+    static const size_t BLOCK_ROWS = 4096;
+
+    Column<uint8_t> age;
+    Column<uint8_t> sleepHours;
+    Column<uint8_t> gender;
+    Column<uint8_t> activityLevel;
+    Column<uint8_t> lifestyle;
+    Column<uint8_t> dietaryPref;
+    Column<uint8_t> goal;
+    Column<double> height;  // in meters
+    Column<double> weight;  // in kg
+    Column<double> waist;   // circumferences in cm, 0 if not measured
+    Column<double> neck;
+    Column<double> hip;
+
+    // Calculated values
+    Column<double> bmi;
+    Column<double> bmr;
+    Column<double> dailyCalories;
+    Column<double> bodyFatPercent;
+    Column<double> leanBodyMass;
+
+    // Macronutrient grams, from calculateMacros
+    Column<double> carbsGrams;
+    Column<double> proteinGrams;
+    Column<double> fatsGrams;
+
+    size_t size() const { return age.size(); }
+    size_t blockCount() const { return (size() + BLOCK_ROWS - 1) / BLOCK_ROWS; }
+
+    void resize(size_t rows);
+
+    void append(const UserProfile& profile) {
+        size_t row = size();
+        resize(row + 1);
+        set(row, profile);
+    }
+
+    void set(size_t row, const UserProfile& profile);
+
+    UserProfile row(size_t i) const;
+
+    // Packs the input fields of row i; false if they are out of range
+    bool pack(size_t i, PackedProfile& packed) const {
+        return PackedProfile::pack(age[i], sleepHours[i], gender[i], activityLevel[i], lifestyle[i],
+                                   dietaryPref[i], goal[i], height[i], weight[i], waist[i], neck[i],
+                                   hip[i], packed);
+    }
+
+    // Unpacks count profiles into the input columns of rows [first, first + count);
+    // metrics are left to calculateMetrics
+    void unpack(size_t first, const PackedProfile* packed, size_t count);
+
+    // Batch counterpart of WellnessBot::calculateMetrics over rows [begin, end)
+    void calculateMetrics(const WellnessBot& bot, size_t begin, size_t end) {
+        calculateMetrics(bot.config(), begin, end);
+    }
+
+    void calculateMetrics(const WellnessBot::WellnessConfig& cfg, size_t begin, size_t end) {
+        MetricsView view = {age.data(), gender.data(), activityLevel.data(), height.data(),
+                            weight.data(), waist.data(), neck.data(), hip.data(), bmi.data(),
+                            bmr.data(), dailyCalories.data(), bodyFatPercent.data(),
+                            leanBodyMass.data()};
+        calculateMetrics(cfg, view, begin, end);
+    }
+
+    // Column pointers for the metrics kernel, so callers holding their own
+    // arrays (the C ABI, NumPy) can run it in place
+    struct MetricsView {
+        const uint8_t* age;
+        const uint8_t* gender;
+        const uint8_t* activityLevel;
+        const double* height;
+        const double* weight;
+        const double* waist;
+        const double* neck;
+        const double* hip;
+        double* bmi;
+        double* bmr;
+        double* dailyCalories;
+        double* bodyFatPercent;
+        double* leanBodyMass;
+    };
+
+    static void calculateMetrics(const WellnessBot::WellnessConfig& cfg, const MetricsView& v,
+                                 size_t begin, size_t end);
+
+    void calculateMetrics(const WellnessBot& bot) {
+        calculateMetrics(bot, 0, size());
+    }
+
+    // Macronutrient gram columns for rows [begin, end); needs dailyCalories.
+    // Each row looks up its (diet, activity, goal) profile in the config table.
+    void calculateMacros(const WellnessBot::WellnessConfig& cfg, size_t begin, size_t end);
+
+    WellnessBot::MacroGrams macros(size_t i) const {
+        return {carbsGrams[i], proteinGrams[i], fatsGrams[i]};
+    }
+
+    WellnessBot::BMICategory bmiCategory(size_t i, const WellnessBot::WellnessConfig& cfg,
+                                         const WellnessBot::GrowthChart* chart) const {
+        return WellnessBot::bmiCategory(bmi[i], age[i], gender[i], cfg, chart);
+    }
+
+    // Recommendation bitmasks for rows [begin, end); needs bmi
+    void recommendationMasks(const WellnessBot::WellnessConfig& cfg, const WellnessBot::GrowthChart* chart,
+                             size_t begin, size_t end, uint32_t* masks) const {
+        for (size_t i = begin; i < end; i++)
+            masks[i] = WellnessBot::recommendationMask(bmiCategory(i, cfg, chart), sleepHours[i],
+                                                       dietaryPref[i], lifestyle[i]);
+    }
+
+private:
+    static string decode(const char* const* names, uint8_t count, uint8_t code) {
+        return code < count ? names[code] : "";
+    }
+
+#ifdef __AVX2__
+    // Writes field (codes >> shift) & mask of four profiles as four bytes
+    static void storeField(__m128i codes, int shift, uint32_t mask, uint8_t* out) {
+        __m128i values = _mm_and_si128(_mm_srl_epi32(codes, _mm_cvtsi32_si128(shift)),
+                                       _mm_set1_epi32(static_cast<int>(mask)));
+        values = _mm_shuffle_epi8(values, _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1,
+                                                        -1, -1, -1, -1, -1, -1, -1, -1));
+        uint32_t bytes = static_cast<uint32_t>(_mm_cvtsi128_si32(values));
+        memcpy(out, &bytes, sizeof(bytes));
+    }
+#endif
+};
+
+// Population queries over per-user recommendation bitmasks, for campaign
+// targeting. Each is a single branch-free pass over the masks.
+class RecommendationMasks {
+public:
+    typedef array<uint64_t, WellnessBot::RECOMMENDATION_COUNT> Counts;
+
+    // Adds to counts how many masks have each recommendation. Each mask byte
+    // is spread to one byte-wide counter per bit by a table lookup, so eight
+    // bits are counted with one add; counters are flushed before they overflow.
+    static void count(const uint32_t* masks, size_t n, Counts& counts);
+
+    // Number of masks with every bit of required and none of excluded
+    static size_t countMatching(const uint32_t* masks, size_t n, uint32_t required, uint32_t excluded) {
+        size_t matches = 0;
+        for (size_t i = 0; i < n; i++)
+            matches += (masks[i] & (required | excluded)) == required;
+        return matches;
+    }
+
+    // Rows matching as in countMatching, in row order
+    static void select(const uint32_t* masks, size_t n, uint32_t required, uint32_t excluded,
+                       vector<uint32_t>& rows);
+};
+
+// Plans weight change toward a BMI boundary: the target weight inverts the
+// BMI formula, then a weekly schedule applies a bounded deficit (or surplus)
+// to maintenance calories recomputed from each week's weight.
+class GoalPlanner {
+public:
+    typedef WellnessBot::UserProfile UserProfile;
+    typedef WellnessBot::WellnessConfig WellnessConfig;
+
+    // Safe rate bounds
+    static constexpr double MAX_DEFICIT_FRACTION = 0.20;       // of maintenance calories
+    static constexpr double MAX_SURPLUS_FRACTION = 0.10;
+    static constexpr double MAX_WEEKLY_LOSS_FRACTION = 0.01;   // of body weight
+    static constexpr double MAX_WEEKLY_GAIN_FRACTION = 0.005;
+    static constexpr double MIN_INTAKE_MALE = 1500.0, MIN_INTAKE_FEMALE = 1200.0;  // adults only
+    static constexpr double TARGET_MARGIN_BMI = 0.1;  // inside the normal band, not on its edge
+    static constexpr double CALORIES_PER_KG = 7700.0;
+    static constexpr double TOLERANCE_KG = 0.01;
+    static const int MAX_WEEKS = 520;
+    static const uint16_t UNREACHABLE = 0xFFFF;  // intake floor leaves no deficit
+    static const int PRINTED_WEEK_STEP = 4;
+
+    struct PlanWeek {
+        int week;
+        double weight;        // at the start of the week, in kg
+        double maintenance;   // calories/day
+        double intake;        // calories/day
+    };
+
+    struct GoalPlan {
+        double targetBmi;
+        double targetWeight;
+        bool reachable;
+        vector<PlanWeek> weeks;
+    };
+
+    // Per-row results of planBatch
+    struct GoalPlans {
+        Column<double> targetWeight;
+        Column<double> startIntake;  // calories/day in the first week
+        Column<uint16_t> weeks;      // UNREACHABLE if the goal cannot be reached
+
+        void resize(size_t rows) {
+            targetWeight.resize(rows);
+            startIntake.resize(rows);
+            weeks.resize(rows);
+        }
+    };
+
+    // Nearest BMI rated normal weight, or the current BMI if already normal.
+    // bmiThresholds.normal itself rates overweight, so the upper target sits
+    // just below it.
+    static double targetBmi(double bmi, const WellnessConfig& cfg) {
+        const WellnessBot::BMIThresholds& t = cfg.bmiThresholds;
+        if (bmi >= t.normal)
+            return max(t.underweight, t.normal - TARGET_MARGIN_BMI);
+        if (bmi < t.underweight)
+            return t.underweight;
+        return bmi;
+    }
+
+    // The fixed intake floors are adult guidance; children are held to the
+    // relative rate bounds only
+    static double minIntake(bool male, int age) {
+        if (age < WellnessBot::ADULT_AGE)
+            return 0.0;
+        return male ? MIN_INTAKE_MALE : MIN_INTAKE_FEMALE;
+    }
+
+    static double targetWeight(double targetBmi, double height) {
+        return targetBmi * height * height;
+    }
+
+    // Advances weight by one week from maintenance calories and returns the
+    // daily intake. The rate is capped by the safe bounds and by the distance
+    // left, so the last week lands on the target.
+    static double advanceWeek(double& weight, double target, double maintenance, double minIntake);
+
+    // Maintenance calories at a given weight. Katch-McArdle holds lean mass
+    // fixed, so its BMR does not change as fat is lost.
+    static double maintenance(const WellnessConfig& cfg, bool male, double weight, double height,
+                              int age, double bmr, double multiplier) {
+        if (cfg.bmrFormula == WellnessBot::BMR_KATCH_MCARDLE)
+            return bmr * multiplier;
+        return WellnessBot::basalMetabolicRate(male, weight, height, age) * multiplier;
+    }
+
+    // Weekly schedule for one profile; needs calculated metrics
+    static GoalPlan plan(const UserProfile& profile, const WellnessConfig& cfg, double targetBmi);
+
+    static GoalPlan plan(const UserProfile& profile, const WellnessConfig& cfg) {
+        return plan(profile, cfg, targetBmi(profile.bmi, cfg));
+    }
+
+    // Every PRINTED_WEEK_STEP-th week of the schedule and its last week
+    static void printPlan(const GoalPlan& plan, const WellnessBot::MessageCatalog& catalog, ostream& out);
+
+    // Weeks advanceWeek takes from weight to target, in closed form.
+    // Maintenance is alpha * weight + beta, so every rate bound is a line in
+    // weight. While one bound binds, weight moves geometrically toward that
+    // line's zero; each segment ends where another bound (or the final,
+    // distance-capped week) takes over, so a plan is a few log/pow steps.
+    static uint16_t weeksToTarget(double weight, double target, double alpha, double beta,
+                                  double minIntake);
+
+    // Plans rows [begin, end) toward their nearest normal-weight boundary;
+    // needs calculated metrics
+    static void planBatch(const ProfileColumns& columns, const WellnessConfig& cfg, size_t begin,
+                          size_t end, GoalPlans& plans);
+};
+
+// Inclusive range predicate over the numeric profile columns
+struct RangeQuery {
+    int minAge = 0;
+    int maxAge = numeric_limits<int>::max();
+    double minBmi = -numeric_limits<double>::infinity();
+    double maxBmi = numeric_limits<double>::infinity();
+    double minHeight = -numeric_limits<double>::infinity();
+    double maxHeight = numeric_limits<double>::infinity();
+    double minWeight = -numeric_limits<double>::infinity();
+    double maxWeight = numeric_limits<double>::infinity();
+
+    bool matches(const ProfileColumns& columns, size_t row) const {
+        return columns.age[row] >= minAge && columns.age[row] <= maxAge &&
+               columns.bmi[row] >= minBmi && columns.bmi[row] <= maxBmi &&
+               columns.height[row] >= minHeight && columns.height[row] <= maxHeight &&
+               columns.weight[row] >= minWeight && columns.weight[row] <= maxWeight;
+    }
+};
+
+// Per-block min/max of each numeric column, used to skip blocks a range
+// predicate cannot match. Rebuild after appending rows or recomputing metrics.
+class ZoneMaps {
+public:
+    struct Zone {
+        uint8_t minAge, maxAge;
+        double minBmi, maxBmi;
+        double minHeight, maxHeight;
+        double minWeight, maxWeight;
+    };
+
+    void build(const ProfileColumns& columns);
+
+    bool mayMatch(size_t block, const RangeQuery& q) const {
+        const Zone& z = zones[block];
+        return z.maxAge >= q.minAge && z.minAge <= q.maxAge &&
+               z.maxBmi >= q.minBmi && z.minBmi <= q.maxBmi &&
+               z.maxHeight >= q.minHeight && z.minHeight <= q.maxHeight &&
+               z.maxWeight >= q.minWeight && z.minWeight <= q.maxWeight;
+    }
+
+    size_t size() const { return zones.size(); }
+
+    // Matching row numbers in ascending order, scanning only candidate blocks
+    vector<uint32_t> select(const ProfileColumns& columns, const RangeQuery& q) const;
+
+    // Reference full scan without block skipping
+    static vector<uint32_t> scan(const ProfileColumns& columns, const RangeQuery& q) {
+        vector<uint32_t> rows;
+        for (size_t i = 0; i < columns.size(); i++) {
+            if (q.matches(columns, i))
+                rows.push_back(static_cast<uint32_t>(i));
+        }
+        return rows;
+    }
+
+private:
+    vector<Zone> zones;
+};
+
+// Elias-Fano encoding of a sorted list of row numbers: low bits packed,
+// high bits in unary, about 2 + log2(universe / count) bits per entry
+class EliasFano {
+public:
+    EliasFano() = default;
+
+    EliasFano(const vector<uint32_t>& sorted, uint64_t universe);
+
+    size_t size() const { return count; }
+    size_t bytes() const { return (lower.size() + upper.size()) * sizeof(uint64_t); }
+
+    // Calls f(row) for every entry in ascending order
+    template<typename F>
+    void forEach(F f) const {
+        uint64_t lowMask = (uint64_t(1) << lowBits) - 1;
+        size_t i = 0;
+        for (size_t w = 0; w < upper.size() && i < count; w++) {
+            uint64_t word = upper[w];
+            while (word != 0) {
+                size_t position = w * 64 + __builtin_ctzll(word);
+                word &= word - 1;
+                uint64_t low = 0;
+                if (lowBits > 0) {
+                    size_t bit = i * lowBits;
+                    low = lower[bit / 64] >> (bit % 64);
+                    if (bit % 64 + lowBits > 64)
+                        low |= lower[bit / 64 + 1] << (64 - bit % 64);
+                    low &= lowMask;
+                }
+                f(static_cast<uint32_t>(((position - i) << lowBits) | low));
+                i++;
+            }
+        }
+    }
+
+private:
+    size_t count = 0;
+    int lowBits = 0;
+    vector<uint64_t> lower;
+    vector<uint64_t> upper;
+};
+
+// Sorted secondary indexes: Elias-Fano postings of row numbers per age band
+// and per BMI band. Queries read the postings of the more selective column.
+class BandIndex {
+public:
+    static const int AGE_BAND_YEARS = 5;
+    static const int AGE_BANDS = 256 / AGE_BAND_YEARS + 1;
+    static const int BMI_BAND_WIDTH = 2;
+    static const int BMI_BANDS = 40;  // last band holds BMI >= 78 and NaN
+
+    static int ageBand(int age) { return age / AGE_BAND_YEARS; }
+
+    static int bmiBand(double bmi) {
+        if (bmi < 0.0)
+            return 0;
+        if (!(bmi < BMI_BANDS * BMI_BAND_WIDTH))
+            return BMI_BANDS - 1;
+        return static_cast<int>(bmi / BMI_BAND_WIDTH);
+    }
+
+    void build(const ProfileColumns& columns);
+
+    // Matching row numbers in ascending order. Only the postings of the more
+    // selective column are decoded, and only those rows are read.
+    vector<uint32_t> select(const ProfileColumns& columns, const RangeQuery& q) const;
+
+    size_t bytes() const {
+        size_t total = 0;
+        for (const auto& p : agePostings)
+            total += p.bytes();
+        for (const auto& p : bmiPostings)
+            total += p.bytes();
+        return total;
+    }
+
+private:
+    vector<EliasFano> agePostings;
+    vector<EliasFano> bmiPostings;
+
+    // Sorted union of the postings for bands [low, high]
+    static vector<uint32_t> candidates(const vector<EliasFano>& postings, int low, int high);
+};
+
+// NUMA nodes and the CPUs on them this process may run on, read from sysfs
+// and the affinity mask (which also reflects cgroup cpusets). Falls back to
+// a single node holding every allowed CPU when the kernel exposes no topology.
+class NumaTopology {
+public:
+    struct Node {
+        int id;
+        vector<int> cpus;
+    };
+
+    vector<Node> nodes;
+
+    static NumaTopology detect();
+
+    // Parses sysfs CPU lists such as "0-3,8-11"
+    static vector<int> parseCpuList(const string& text);
+
+    // Moves the whole pages inside [addr, addr + len) to a node's memory.
+    // Returns false when the kernel has no NUMA support or refuses.
+    static bool bindMemory(void* addr, size_t len, int node);
+
+    // 0, or the error number when the thread cannot be pinned
+    static int pinCurrentThread(const vector<int>& cpus) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int c : cpus) {
+            if (c >= 0 && c < CPU_SETSIZE)
+                CPU_SET(c, &set);
+        }
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+};
+
+// Persistent worker threads grouped by NUMA node, each pinned to its node's
+// CPUs. Work is split so that every node processes its own row range, which
+// NumaBatch places in that node's memory.
+class NumaWorkerPool {
+public:
+    typedef function<void(size_t node, unsigned index, unsigned count)> Task;
+
+    // threadsPerNode = 0 uses one thread per CPU of each node. Returns once
+    // every worker has tried to pin itself; failures are reported on stderr
+    // and those workers run unpinned.
+    explicit NumaWorkerPool(const NumaTopology& topology, unsigned threadsPerNode = 0);
+
+    ~NumaWorkerPool();
+
+    size_t nodeCount() const { return nodeThreads.size(); }
+    unsigned threadsOn(size_t node) const { return nodeThreads[node]; }
+    unsigned threadCount() const { return static_cast<unsigned>(workers.size()); }
+
+    // Index of a worker among all of them, for per-worker partials
+    unsigned slot(size_t node, unsigned index) const {
+        unsigned before = 0;
+        for (size_t n = 0; n < node; n++)
+            before += nodeThreads[n];
+        return before + index;
+    }
+
+    // Runs task on every worker and waits for all of them to finish
+    void run(const Task& task);
+
+    // Block-aligned row range owned by a node, proportional to its thread count
+    pair<size_t, size_t> nodeRange(size_t node, size_t rows) const;
+
+    // Block-aligned slice of a node's range handled by one of its threads
+    pair<size_t, size_t> threadRange(size_t node, unsigned index, size_t rows) const {
+        pair<size_t, size_t> range = nodeRange(node, rows);
+        size_t blocks = (range.second - range.first + ProfileColumns::BLOCK_ROWS - 1) /
+                        ProfileColumns::BLOCK_ROWS;
+        unsigned count = nodeThreads[node];
+        size_t begin = range.first + blocks * index / count * ProfileColumns::BLOCK_ROWS;
+        size_t end = range.first + blocks * (index + 1) / count * ProfileColumns::BLOCK_ROWS;
+        return {min(range.second, begin), min(range.second, end)};
+    }
+
+private:
+    const NumaTopology& topology;
+    vector<unsigned> nodeThreads;
+    vector<thread> workers;
+    mutex poolMutex;
+    condition_variable wake;
+    condition_variable done;
+    const Task* current = nullptr;
+    uint64_t generation = 0;
+    unsigned pending = 0;
+    bool stopping = false;
+    exception_ptr failure;
+    unsigned unpinned = 0;
+    int pinError = 0;
+
+    void workerLoop(size_t node, unsigned index, unsigned count);
+};
+
+// NUMA-aware placement and batch paths over a ProfileColumns store
+class NumaBatch {
+public:
+    // Moves each node's row range of every column into that node's memory
+    static bool placeColumns(ProfileColumns& columns, const NumaWorkerPool& pool,
+                             const NumaTopology& topology);
+
+    // Each worker computes metrics and macros for the rows held in its own
+    // node's memory
+    static void calculateMetrics(const WellnessBot& bot, ProfileColumns& columns,
+                                 NumaWorkerPool& pool) {
+        const WellnessBot::WellnessConfig& cfg = bot.config();
+        pool.run([&](size_t node, unsigned index, unsigned) {
+            pair<size_t, size_t> range = pool.threadRange(node, index, columns.size());
+            columns.calculateMetrics(cfg, range.first, range.second);
+            columns.calculateMacros(cfg, range.first, range.second);
+        });
+    }
+
+    // Cohort aggregates with one node-local partial per worker, merged at the end
+    static CohortViews::Snapshot aggregate(const WellnessBot& bot, const ProfileColumns& columns,
+                                           NumaWorkerPool& pool);
+
+private:
+    template<typename T>
+    static bool bindRows(Column<T>& column, pair<size_t, size_t> range, int node) {
+        if (range.second <= range.first)
+            return true;
+        return NumaTopology::bindMemory(column.data() + range.first,
+                                        (range.second - range.first) * sizeof(T), node);
+    }
+};
+
+// Profiles as points for similarity search and clustering: eight features,
+// each scaled to zero mean and unit variance over a population so that no
+// unit dominates distances. A point is eight floats, one AVX register.
+class FeatureSpace {
+public:
+    typedef WellnessBot::UserProfile UserProfile;
+
+    static const int DIMENSIONS = 8;
+
+    // Features a point can hold; categoricals are their WellnessBot codes
+    enum Feature {
+        FEATURE_AGE, FEATURE_GENDER, FEATURE_HEIGHT, FEATURE_WEIGHT, FEATURE_BMI, FEATURE_BMR,
+        FEATURE_DAILY_CALORIES, FEATURE_ACTIVITY, FEATURE_SLEEP, FEATURE_LIFESTYLE, FEATURE_DIET
+    };
+    typedef array<Feature, DIMENSIONS> Features;
+
+    // Similar users are close in build and habits
+    static constexpr Features SIMILARITY_FEATURES = {{
+        FEATURE_AGE, FEATURE_HEIGHT, FEATURE_WEIGHT, FEATURE_BMI,
+        FEATURE_ACTIVITY, FEATURE_SLEEP, FEATURE_LIFESTYLE, FEATURE_DIET
+    }};
+    // Personas also differ in energy needs, which carry gender and activity
+    static constexpr Features PERSONA_FEATURES = {{
+        FEATURE_AGE, FEATURE_BMI, FEATURE_BMR, FEATURE_DAILY_CALORIES,
+        FEATURE_ACTIVITY, FEATURE_SLEEP, FEATURE_LIFESTYLE, FEATURE_DIET
+    }};
+
+    struct Point {
+        float f[DIMENSIONS];
+    };
+    typedef Column<Point> Points;
+
+    Features features = SIMILARITY_FEATURES;
+    array<double, DIMENSIONS> mean{};
+    array<double, DIMENSIONS> scale{};  // 1 / standard deviation; 1 for a constant feature
+
+    // Fitted to rows with metrics calculated, one partial per worker merged
+    // with Chan's update so large populations lose no precision
+    static FeatureSpace fit(const ProfileColumns& columns, NumaWorkerPool& pool,
+                            const Features& features = SIMILARITY_FEATURES);
+
+    Point point(const UserProfile& profile) const {
+        double raw[DIMENSIONS];
+        for (int d = 0; d < DIMENSIONS; d++)
+            raw[d] = value(profile, features[d]);
+        return scaled(raw);
+    }
+
+    Point point(const ProfileColumns& columns, size_t row) const {
+        double raw[DIMENSIONS];
+        rawFeatures(columns, row, raw);
+        return scaled(raw);
+    }
+
+    // Summed as ((d0 + d1) + (d2 + d3)) + ((d4 + d5) + (d6 + d7)), the order
+    // the vector kernel adds in, so both give identical distances
+    static float squaredDistance(const Point& a, const Point& b) {
+        float d[DIMENSIONS];
+        for (int i = 0; i < DIMENSIONS; i++)
+            d[i] = (a.f[i] - b.f[i]) * (a.f[i] - b.f[i]);
+        return ((d[0] + d[1]) + (d[2] + d[3])) + ((d[4] + d[5]) + (d[6] + d[7]));
+    }
+
+    // out[i] = squaredDistance(points[i], query)
+    static void squaredDistances(const Point* points, size_t count, const Point& query, float* out);
+
+    // Index of the center nearest to point
+    static size_t nearest(const Point* centers, size_t count, const Point& point);
+
+private:
+    void rawFeatures(const ProfileColumns& columns, size_t i, double* raw) const {
+        for (int d = 0; d < DIMENSIONS; d++)
+            raw[d] = value(columns, i, features[d]);
+    }
+
+    static double value(const ProfileColumns& columns, size_t i, Feature feature);
+
+    static double value(const UserProfile& profile, Feature feature);
+
+    Point scaled(const double* raw) const {
+        Point p;
+        for (int d = 0; d < DIMENSIONS; d++)
+            p.f[d] = static_cast<float>((raw[d] - mean[d]) * scale[d]);
+        return p;
+    }
+};
+
+// "Users like you": the profiles nearest to a query in a FeatureSpace.
+// Small populations are searched exhaustively. Larger ones are split into
+// inverted lists of the points nearest each of about sqrt(n) centroids, and a
+// query scans only the lists of the centroids closest to it. Centroids come
+// from a two-level k-means on a sample, so assigning n points costs about
+// 2 * n^(1/4) distances each rather than sqrt(n).
+class SimilarityIndex {
+public:
+    typedef WellnessBot::UserProfile UserProfile;
+    typedef FeatureSpace::Point Point;
+
+    static const size_t EXACT_MAX_ROWS = 100000;
+    static const size_t DEFAULT_PROBES = 8;
+    static const size_t SAMPLE_PER_LIST = 32;   // training points per centroid
+    static const int TRAINING_ITERATIONS = 8;
+
+    struct Neighbor {
+        float distance;  // squared, in standardized units
+        uint32_t row;
+
+        // Ties go to the lower row, so results do not depend on scan order
+        bool operator<(const Neighbor& other) const {
+            return distance < other.distance || (distance == other.distance && row < other.row);
+        }
+    };
+
+    // Indexes every row of columns, whose metrics must be calculated. lists
+    // = 0 picks exhaustive search or a list count from the population size.
+    SimilarityIndex(const ProfileColumns& columns, NumaWorkerPool& pool, size_t lists = 0);
+
+    const FeatureSpace& space() const { return featureSpace; }
+    size_t size() const { return points.size(); }
+    size_t listCount() const { return centroids.size(); }  // 0 when searched exhaustively
+
+    // Up to k nearest rows, nearest first. probes is the number of lists
+    // scanned; more trade speed for recall.
+    vector<Neighbor> search(const UserProfile& profile, size_t k, size_t probes = DEFAULT_PROBES) const {
+        return search(featureSpace.point(profile), k, probes);
+    }
+
+    vector<Neighbor> search(const Point& query, size_t k, size_t probes = DEFAULT_PROBES) const;
+
+    // Exhaustive search, whatever the index; the reference for recall
+    vector<Neighbor> searchExact(const Point& query, size_t k) const {
+        vector<Neighbor> heap;
+        heap.reserve(k + 1);
+        scan(0, points.size(), query, k, heap);
+        sort_heap(heap.begin(), heap.end());
+        return heap;
+    }
+
+private:
+    FeatureSpace featureSpace;
+    FeatureSpace::Points points;      // grouped by list when indexed, else in row order
+    Column<uint32_t> rows;            // row of each point; empty when in row order
+    FeatureSpace::Points centroids;
+    vector<size_t> listStart;         // listCount() + 1 offsets into points
+    vector<Point> groupCentroids;     // first level; each owns a run of centroids
+    vector<size_t> groupFirstList;    // groupCentroids.size() + 1 offsets into centroids
+
+    // Offers points [begin, end) to a max-heap of the k nearest so far
+    void scan(size_t begin, size_t end, const Point& query, size_t k, vector<Neighbor>& heap) const;
+
+    // Two-level k-means on an evenly strided sample: about sqrt(lists) groups,
+    // then each group's sample split into its share of the lists
+    void trainCentroids(const ProfileColumns& columns, NumaWorkerPool& pool, size_t lists);
+
+    // Assigns every row to a list, then scatters points grouped by list.
+    // Each worker owns a block-aligned row range and a slice of every list.
+    void buildLists(const ProfileColumns& columns, NumaWorkerPool& pool);
+
+    // Nearest group, then the nearest of that group's lists
+    uint32_t assign(const Point& p) const {
+        size_t g = FeatureSpace::nearest(groupCentroids.data(), groupCentroids.size(), p);
+        size_t first = groupFirstList[g];
+        return static_cast<uint32_t>(first + FeatureSpace::nearest(centroids.data() + first,
+                                                                   groupFirstList[g + 1] - first, p));
+    }
+
+    // Lloyd's algorithm from k evenly strided points (k <= data.size()); a
+    // center that loses all its points keeps its place. Assignment is split across the pool's
+    // workers when one is given.
+    static vector<Point> kMeans(const vector<Point>& data, size_t k, NumaWorkerPool* pool);
+};
+
+// Population personas: k-means clusters of profiles over PERSONA_FEATURES.
+// Centers are seeded with k-means++ on a sample and refined with mini-batch
+// updates (Sculley, "Web-scale k-means clustering"), so training cost does
+// not grow with the population. One parallel pass then assigns every row
+// and summarizes each cluster. Clusters are numbered by size, largest first.
+class PopulationClusters {
+public:
+    typedef WellnessBot::UserProfile UserProfile;
+    typedef FeatureSpace::Point Point;
+
+    static const size_t SEED_SAMPLE_ROWS = 65536;
+    static const size_t BATCH_ROWS = 8192;
+    static const int ITERATIONS = 100;
+
+    // Summary of one cluster's members
+    struct Persona {
+        Point center;               // standardized feature space
+        uint64_t users = 0;
+        double age = 0;             // means
+        double bmi = 0;
+        double bmr = 0;
+        double dailyCalories = 0;
+        double sleepHours = 0;
+        array<uint64_t, WellnessBot::BMI_CATEGORY_COUNT> bmiCategories{};
+        array<uint64_t, WellnessBot::GENDER_COUNT> genders{};
+        array<uint64_t, WellnessBot::ACTIVITY_COUNT> activityLevels{};
+        array<uint64_t, WellnessBot::LIFESTYLE_COUNT> lifestyles{};
+        array<uint64_t, WellnessBot::DIET_COUNT> diets{};
+    };
+
+    // Clusters every row of columns, whose metrics must be calculated, into
+    // k personas (fewer if there are fewer rows); chart rates the children's
+    // BMI categories when not null
+    PopulationClusters(const ProfileColumns& columns, NumaWorkerPool& pool, size_t k,
+                       const WellnessBot::WellnessConfig& cfg, const WellnessBot::GrowthChart* chart,
+                       uint32_t seed = 1);
+
+    size_t size() const { return centers.size(); }
+    const FeatureSpace& space() const { return featureSpace; }
+    const vector<Persona>& personas() const { return summaries; }
+
+    // Mean squared distance from each row to its center, in standardized units
+    double meanSquaredDistance() const { return inertia; }
+
+    // Persona of a new profile with metrics calculated: k distances, no allocation
+    size_t assign(const UserProfile& profile) const {
+        Point p = featureSpace.point(profile);
+        return FeatureSpace::nearest(centers.data(), centers.size(), p);
+    }
+
+    void print(ostream& out) const;
+
+private:
+    FeatureSpace featureSpace;
+    vector<Point> centers;
+    vector<Persona> summaries;
+    double inertia = 0;
+
+    // k-means++: each next center is a sampled row drawn with probability
+    // proportional to its squared distance from the nearest center so far
+    void seedCenters(const ProfileColumns& columns, size_t k, mt19937_64& rng);
+
+    // Mini-batch k-means: workers assign slices of a random batch in
+    // parallel, then each center moves toward its points with a step of
+    // 1 / (points it has seen)
+    void refine(const ProfileColumns& columns, NumaWorkerPool& pool, mt19937_64& rng);
+
+    // Assigns every row with one partial summary per worker, then orders
+    // clusters by size
+    void summarize(const ProfileColumns& columns, NumaWorkerPool& pool,
+                   const WellnessBot::WellnessConfig& cfg, const WellnessBot::GrowthChart* chart);
+
+    static void merge(Persona& total, const Persona& part);
+
+    static double percent(uint64_t part, uint64_t total) {
+        return total ? 100.0 * static_cast<double>(part) / static_cast<double>(total) : 0.0;
+    }
+
+    // Most common value and its share, e.g. "female (61.2%)"
+    template<size_t N>
+    static string dominant(const char* const* names, const array<uint64_t, N>& counts, uint64_t users) {
+        size_t best = max_element(counts.begin(), counts.end()) - counts.begin();
+        ostringstream text;
+        text << names[best] << " (" << fixed << setprecision(1) << percent(counts[best], users) << "%)";
+        return text.str();
+    }
+};
+
+// Reads profile records from batch input files, one per line:
+//   userId,age,gender,height,weight,activityLevel,sleepHours,lifestyle,dietaryPref[,goal[,waist,neck,hip]]
+// Circumferences are in cm; an empty or 0 value means not measured.
+// Values must satisfy the same rules collectUserData enforces.
+class ProfileCsv {
+public:
+    typedef WellnessBot::UserProfile UserProfile;
+
+    static const int FIELD_COUNT = 13;
+    static const int REQUIRED_FIELDS = 9;
+
+    static bool parse(const string& line, uint64_t& userId, UserProfile& profile);
+
+    // Appends every valid record of a file to columns and returns the number
+    // of lines skipped as invalid
+    static size_t load(const string& path, ProfileColumns& columns);
+
+private:
+    static string trim(const string& value) {
+        size_t first = value.find_first_not_of(" \t\r");
+        if (first == string::npos)
+            return "";
+        size_t last = value.find_last_not_of(" \t\r");
+        return value.substr(first, last - first + 1);
+    }
+
+    static string lower(string value) {
+        transform(value.begin(), value.end(), value.begin(), ::tolower);
+        return value;
+    }
+
+    static bool parseUnsigned(const string& text, uint64_t& value) {
+        if (text.empty() || !isdigit(static_cast<unsigned char>(text[0])))
+            return false;
+        char* end;
+        errno = 0;
+        value = strtoull(text.c_str(), &end, 10);
+        return errno == 0 && *end == '\0';
+    }
+
+    static bool parseLong(const string& text, long& value) {
+        if (text.empty())
+            return false;
+        char* end;
+        errno = 0;
+        value = strtol(text.c_str(), &end, 10);
+        return errno == 0 && *end == '\0';
+    }
+
+    // Empty or 0 means not measured
+    static bool parseCircumference(const string& text, double& value) {
+        value = 0;
+        if (text.empty())
+            return true;
+        if (!WellnessBot::parseCircumference(text, value))
+            return false;
+        return value == 0 ||
+               (value >= WellnessBot::MIN_CIRCUMFERENCE && value <= WellnessBot::MAX_CIRCUMFERENCE);
+    }
+};
+
+
+#endif  // WELLNESS_CORE_H